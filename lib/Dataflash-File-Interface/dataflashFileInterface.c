@@ -101,12 +101,15 @@ int8_t DF_FLUSH(void *file) {
 }
 
 embedDBFileInterface *getDataflashInterface() {
-    embedDBFileInterface *fileInterface = malloc(sizeof(embedDBFileInterface));
+    embedDBFileInterface *fileInterface = calloc(1, sizeof(embedDBFileInterface));
     fileInterface->close = DF_CLOSE;
     fileInterface->read = DF_READ;
     fileInterface->write = DF_WRITE;
     fileInterface->erase = DF_ERASE;
     fileInterface->open = DF_OPEN;
     fileInterface->flush = DF_FLUSH;
+    fileInterface->readPages = NULL;
+    fileInterface->submitRead = NULL;
+    fileInterface->waitRead = NULL;
     return fileInterface;
 }
@@ -1,8 +1,91 @@
 #include "desktopFileInterface.h"
 
+#if defined(DESKTOP_FILE_INTERFACE_VECTORED_IO_SUPPORTED)
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#if defined(DESKTOP_FILE_INTERFACE_MMAP_SUPPORTED)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Minimum number of bytes the memory-mapped file grows by when a write goes past the end of the mapping */
+#define MMAP_MIN_GROWTH (1024 * 1024)
+#endif
+
+#if defined(DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED)
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
+/* Maximum number of reads each file can have in flight */
+#define URING_QUEUE_DEPTH 64
+
+typedef struct {
+    int ringFd;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+    void *sqRing;
+    size_t sqRingSize;
+    void *cqRing;
+    size_t cqRingSize;
+    size_t sqesSize;
+    uint32_t pageSize;                           /* Size of the reads that were submitted */
+    uint32_t numInFlight;                        /* Reads submitted and not yet returned by URING_WAIT_READ */
+    uint32_t numCompleted;                       /* Reads that finished while waiting for a different buffer */
+    void *completedBuffers[URING_QUEUE_DEPTH];   /* Buffers of the reads that finished */
+    int32_t completedResults[URING_QUEUE_DEPTH]; /* Bytes read, or a negative error, for each read that finished */
+} URING;
+#endif
+
+#if defined(DESKTOP_FILE_INTERFACE_BACKGROUND_WRITER_SUPPORTED)
+#include <pthread.h>
+
+/* Number of pages each file can have waiting for the writer thread before a write blocks */
+#define BACKGROUND_WRITER_QUEUE_DEPTH 8
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;                             /* Signalled when a page is queued, a page is written, or the writer is told to stop */
+    int fd;                                             /* File descriptor the writer thread writes to */
+    uint8_t *pages;                                     /* Copies of the queued pages, BACKGROUND_WRITER_QUEUE_DEPTH pages of pageSize bytes. Allocated on the first write */
+    uint32_t pageNums[BACKGROUND_WRITER_QUEUE_DEPTH];   /* Page number each queued page is written to */
+    uint32_t pageSize;                                  /* Size of the queued pages */
+    uint32_t head;                                      /* Slot of the oldest queued page, the one being written */
+    uint32_t count;                                     /* Number of queued pages, including the one being written */
+    uint8_t failed;                                     /* 1 if a write failed since the last flush */
+    uint8_t stop;                                       /* 1 once the writer thread should exit after writing every queued page */
+} BACKGROUND_WRITER;
+#endif
+
 typedef struct {
     char *filename;
     FILE *file;
+#if defined(DESKTOP_FILE_INTERFACE_MMAP_SUPPORTED)
+    int fd;            /* File descriptor used by the memory-mapped interface. -1 if not open */
+    uint8_t *map;      /* Start of the memory mapping. NULL if nothing is mapped */
+    size_t mapSize;    /* Number of bytes mapped. The file on disk is always at least this large */
+    size_t fileSize;   /* Number of bytes of the file that hold pages written by embedDB */
+    size_t dirtyStart; /* Offset of the first byte written since the last flush */
+    size_t dirtyEnd;   /* Offset one past the last byte written since the last flush */
+    uint8_t isMapped;  /* 1 if the file was opened by the memory-mapped interface, 0 if by the asynchronous interface */
+#endif
+#if defined(DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED)
+    URING *ring; /* io_uring used by the asynchronous interface. NULL if it could not be set up */
+#endif
+#if defined(DESKTOP_FILE_INTERFACE_BACKGROUND_WRITER_SUPPORTED)
+    BACKGROUND_WRITER *writer; /* Writer thread used by the background writer interface. NULL if the file was not opened by it */
+#endif
 } FILE_INFO;
 
 void *setupFile(char *filename) {
@@ -11,14 +94,51 @@ void *setupFile(char *filename) {
     fileInfo->filename = calloc(1, nameLen + 1);
     memcpy(fileInfo->filename, filename, nameLen);
     fileInfo->file = NULL;
+#if defined(DESKTOP_FILE_INTERFACE_MMAP_SUPPORTED)
+    fileInfo->fd = -1;
+    fileInfo->map = NULL;
+    fileInfo->mapSize = 0;
+    fileInfo->fileSize = 0;
+    fileInfo->dirtyStart = SIZE_MAX;
+    fileInfo->dirtyEnd = 0;
+    fileInfo->isMapped = 0;
+#endif
+#if defined(DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED)
+    fileInfo->ring = NULL;
+#endif
+#if defined(DESKTOP_FILE_INTERFACE_BACKGROUND_WRITER_SUPPORTED)
+    fileInfo->writer = NULL;
+#endif
     return fileInfo;
 }
 
+#if defined(DESKTOP_FILE_INTERFACE_MMAP_SUPPORTED)
+int8_t MMAP_CLOSE(void *file);
+#endif
+#if defined(DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED)
+int8_t URING_CLOSE(void *file);
+#endif
+#if defined(DESKTOP_FILE_INTERFACE_BACKGROUND_WRITER_SUPPORTED)
+int8_t BACKGROUND_CLOSE(void *file);
+#endif
+
 void tearDownFile(void *file) {
     FILE_INFO *fileInfo = (FILE_INFO *)file;
     free(fileInfo->filename);
     if (fileInfo->file != NULL)
         fclose(fileInfo->file);
+#if defined(DESKTOP_FILE_INTERFACE_BACKGROUND_WRITER_SUPPORTED)
+    if (fileInfo->writer != NULL)
+        BACKGROUND_CLOSE(file);
+#endif
+#if defined(DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED)
+    if (fileInfo->fd != -1 && !fileInfo->isMapped)
+        URING_CLOSE(file);
+#endif
+#if defined(DESKTOP_FILE_INTERFACE_MMAP_SUPPORTED)
+    if (fileInfo->fd != -1)
+        MMAP_CLOSE(file);
+#endif
     free(file);
 }
 
@@ -34,6 +154,33 @@ int8_t FILE_WRITE(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file)
     return fwrite(buffer, pageSize, 1, fileInfo->file);
 }
 
+#if defined(DESKTOP_FILE_INTERFACE_VECTORED_IO_SUPPORTED)
+/**
+ * @brief	Reads numPages contiguous pages of a file descriptor with a single preadv call.
+ * @return	1 if every page was read and 0 otherwise
+ */
+static int8_t readPagesVectored(int fd, void **buffers, uint32_t pageNum, uint32_t numPages, uint32_t pageSize) {
+    struct iovec iov[numPages];
+    for (uint32_t i = 0; i < numPages; i++) {
+        iov[i].iov_base = buffers[i];
+        iov[i].iov_len = pageSize;
+    }
+
+    off_t offset = (off_t)pageNum * pageSize;
+    return preadv(fd, iov, numPages, offset) == (ssize_t)((size_t)numPages * pageSize);
+}
+
+int8_t FILE_READ_PAGES(void **buffers, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+
+    /* preadv bypasses the stdio buffer, so any writes still held in it must reach the file first */
+    if (fflush(fileInfo->file) != 0)
+        return 0;
+
+    return readPagesVectored(fileno(fileInfo->file), buffers, pageNum, numPages, pageSize);
+}
+#endif
+
 int8_t FILE_ERASE(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
     return 1;
 }
@@ -91,24 +238,676 @@ int8_t FILE_OPEN(void *file, uint8_t mode) {
     }
 }
 
+#if defined(DESKTOP_FILE_INTERFACE_MMAP_SUPPORTED)
+
+/**
+ * @brief	Grows the file and its mapping so that at least requiredSize bytes are addressable.
+ * 			The file is grown in large steps so that appending pages does not remap on every write.
+ * @return	1 for success and 0 for failure
+ */
+static int8_t mmapReserve(FILE_INFO *fileInfo, size_t requiredSize) {
+    if (requiredSize <= fileInfo->mapSize)
+        return 1;
+
+    size_t newSize = fileInfo->mapSize * 2;
+    if (newSize < requiredSize)
+        newSize = requiredSize;
+    if (newSize < MMAP_MIN_GROWTH)
+        newSize = MMAP_MIN_GROWTH;
+
+    if (ftruncate(fileInfo->fd, (off_t)newSize) != 0) {
+#ifdef PRINT_ERRORS
+        printf("Error: Unable to grow memory-mapped file %s.\n", fileInfo->filename);
+#endif
+        return 0;
+    }
+
+    if (fileInfo->map != NULL)
+        munmap(fileInfo->map, fileInfo->mapSize);
+
+    void *map = mmap(NULL, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileInfo->fd, 0);
+    if (map == MAP_FAILED) {
+#ifdef PRINT_ERRORS
+        printf("Error: Unable to map file %s.\n", fileInfo->filename);
+#endif
+        fileInfo->map = NULL;
+        fileInfo->mapSize = 0;
+        return 0;
+    }
+
+    fileInfo->map = (uint8_t *)map;
+    fileInfo->mapSize = newSize;
+    return 1;
+}
+
+int8_t MMAP_READ(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    size_t offset = (size_t)pageNum * pageSize;
+
+    /* Behave like fread at the end of the file: pages that were never written cannot be read */
+    if (offset + pageSize > fileInfo->fileSize)
+        return 0;
+
+    memcpy(buffer, fileInfo->map + offset, pageSize);
+    return 1;
+}
+
+int8_t MMAP_WRITE(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    size_t offset = (size_t)pageNum * pageSize;
+    size_t end = offset + pageSize;
+
+    if (!mmapReserve(fileInfo, end))
+        return 0;
+
+    memcpy(fileInfo->map + offset, buffer, pageSize);
+
+    if (end > fileInfo->fileSize)
+        fileInfo->fileSize = end;
+    if (offset < fileInfo->dirtyStart)
+        fileInfo->dirtyStart = offset;
+    if (end > fileInfo->dirtyEnd)
+        fileInfo->dirtyEnd = end;
+    return 1;
+}
+
+int8_t MMAP_READ_PAGES(void **buffers, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    size_t offset = (size_t)pageNum * pageSize;
+    if (offset + (size_t)numPages * pageSize > fileInfo->fileSize)
+        return 0;
+
+    for (uint32_t i = 0; i < numPages; i++) {
+        memcpy(buffers[i], fileInfo->map + offset + (size_t)i * pageSize, pageSize);
+    }
+    return 1;
+}
+
+int8_t MMAP_ERASE(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
+    return 1;
+}
+
+int8_t MMAP_FLUSH(void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    if (fileInfo->dirtyEnd == 0)
+        return 1;
+
+    /* msync requires an address aligned to the system page size */
+    size_t systemPageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = fileInfo->dirtyStart - fileInfo->dirtyStart % systemPageSize;
+    if (msync(fileInfo->map + start, fileInfo->dirtyEnd - start, MS_SYNC) != 0)
+        return 0;
+
+    fileInfo->dirtyStart = SIZE_MAX;
+    fileInfo->dirtyEnd = 0;
+    return 1;
+}
+
+int8_t MMAP_CLOSE(void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    if (fileInfo->fd == -1)
+        return 1;
+
+    int8_t success = MMAP_FLUSH(file);
+    if (fileInfo->map != NULL)
+        munmap(fileInfo->map, fileInfo->mapSize);
+
+    /* Drop the space reserved past the last written page so recovery sees the same file size as the stdio interface */
+    if (ftruncate(fileInfo->fd, (off_t)fileInfo->fileSize) != 0)
+        success = 0;
+    close(fileInfo->fd);
+
+    fileInfo->fd = -1;
+    fileInfo->isMapped = 0;
+    fileInfo->map = NULL;
+    fileInfo->mapSize = 0;
+    fileInfo->fileSize = 0;
+    return success;
+}
+
+int8_t MMAP_OPEN(void *file, uint8_t mode) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+
+    if (mode == EMBEDDB_FILE_MODE_W_PLUS_B) {
+        fileInfo->fd = open(fileInfo->filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    } else if (mode == EMBEDDB_FILE_MODE_R_PLUS_B) {
+        fileInfo->fd = open(fileInfo->filename, O_RDWR);
+    } else {
+        return 0;
+    }
+
+    if (fileInfo->fd == -1)
+        return 0;
+
+    struct stat fileStat;
+    if (fstat(fileInfo->fd, &fileStat) != 0) {
+        close(fileInfo->fd);
+        fileInfo->fd = -1;
+        return 0;
+    }
+
+    fileInfo->isMapped = 1;
+    fileInfo->map = NULL;
+    fileInfo->mapSize = 0;
+    fileInfo->fileSize = (size_t)fileStat.st_size;
+    fileInfo->dirtyStart = SIZE_MAX;
+    fileInfo->dirtyEnd = 0;
+
+    /* Map the existing contents so recovery can read them */
+    if (fileInfo->fileSize > 0) {
+        void *map = mmap(NULL, fileInfo->fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fileInfo->fd, 0);
+        if (map == MAP_FAILED) {
+            close(fileInfo->fd);
+            fileInfo->fd = -1;
+            return 0;
+        }
+        fileInfo->map = (uint8_t *)map;
+        fileInfo->mapSize = fileInfo->fileSize;
+    }
+
+    return 1;
+}
+
+embedDBFileInterface *getMmapFileInterface() {
+    embedDBFileInterface *fileInterface = calloc(1, sizeof(embedDBFileInterface));
+    fileInterface->close = MMAP_CLOSE;
+    fileInterface->read = MMAP_READ;
+    fileInterface->write = MMAP_WRITE;
+    fileInterface->erase = MMAP_ERASE;
+    fileInterface->open = MMAP_OPEN;
+    fileInterface->flush = MMAP_FLUSH;
+    fileInterface->readPages = MMAP_READ_PAGES;
+    fileInterface->submitRead = NULL;
+    fileInterface->waitRead = NULL;
+    return fileInterface;
+}
+
+#endif
+
+#if defined(DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED)
+
+static void uringTearDown(URING *ring) {
+    if (ring->sqRing != NULL && ring->sqRing != MAP_FAILED)
+        munmap(ring->sqRing, ring->sqRingSize);
+    if (ring->cqRing != NULL && ring->cqRing != MAP_FAILED)
+        munmap(ring->cqRing, ring->cqRingSize);
+    if (ring->sqes != NULL && (void *)ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqesSize);
+    close(ring->ringFd);
+    free(ring);
+}
+
+/**
+ * @brief	Creates an io_uring and maps its submission and completion queues.
+ * @return	The ring, or NULL if io_uring is not available
+ */
+static URING *uringSetup() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int ringFd = syscall(__NR_io_uring_setup, URING_QUEUE_DEPTH, &params);
+    if (ringFd < 0)
+        return NULL;
+
+    URING *ring = calloc(1, sizeof(URING));
+    if (ring == NULL) {
+        close(ringFd);
+        return NULL;
+    }
+
+    ring->ringFd = ringFd;
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    ring->cqRing = mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || (void *)ring->sqes == MAP_FAILED) {
+        uringTearDown(ring);
+        return NULL;
+    }
+
+    ring->sqHead = (unsigned *)((uint8_t *)ring->sqRing + params.sq_off.head);
+    ring->sqTail = (unsigned *)((uint8_t *)ring->sqRing + params.sq_off.tail);
+    ring->sqMask = (unsigned *)((uint8_t *)ring->sqRing + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *)((uint8_t *)ring->sqRing + params.sq_off.array);
+    ring->cqHead = (unsigned *)((uint8_t *)ring->cqRing + params.cq_off.head);
+    ring->cqTail = (unsigned *)((uint8_t *)ring->cqRing + params.cq_off.tail);
+    ring->cqMask = (unsigned *)((uint8_t *)ring->cqRing + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((uint8_t *)ring->cqRing + params.cq_off.cqes);
+    return ring;
+}
+
+/**
+ * @brief	Moves every finished read from the completion queue to the list of completed reads.
+ * 			Blocks until at least one read finishes if wait is 1.
+ */
+static void uringReap(URING *ring, int8_t wait) {
+    unsigned head = *ring->cqHead;
+    unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    while (head == tail && wait) {
+        int result = syscall(__NR_io_uring_enter, ring->ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (result < 0 && errno != EINTR)
+            return;
+        tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    }
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+        ring->completedBuffers[ring->numCompleted] = (void *)(uintptr_t)cqe->user_data;
+        ring->completedResults[ring->numCompleted] = cqe->res;
+        ring->numCompleted++;
+        head++;
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+}
+
+int8_t URING_SUBMIT_READ(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    URING *ring = fileInfo->ring;
+    if (ring == NULL || ring->numInFlight >= URING_QUEUE_DEPTH)
+        return 0;
+
+    unsigned tail = *ring->sqTail;
+    unsigned index = tail & *ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fileInfo->fd;
+    sqe->addr = (uint64_t)(uintptr_t)buffer;
+    sqe->len = pageSize;
+    sqe->off = (uint64_t)pageNum * pageSize;
+    sqe->user_data = (uint64_t)(uintptr_t)buffer;
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    if (syscall(__NR_io_uring_enter, ring->ringFd, 1, 0, 0, NULL, 0) != 1) {
+        /* The kernel only takes entries during io_uring_enter, so the entry can be withdrawn */
+        __atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    ring->pageSize = pageSize;
+    ring->numInFlight++;
+    return 1;
+}
+
+int8_t URING_WAIT_READ(void *buffer, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    URING *ring = fileInfo->ring;
+    if (ring == NULL)
+        return 0;
+
+    while (1) {
+        for (uint32_t i = 0; i < ring->numCompleted; i++) {
+            if (ring->completedBuffers[i] == buffer) {
+                int32_t result = ring->completedResults[i];
+                ring->numCompleted--;
+                ring->completedBuffers[i] = ring->completedBuffers[ring->numCompleted];
+                ring->completedResults[i] = ring->completedResults[ring->numCompleted];
+                ring->numInFlight--;
+                return result == (int32_t)ring->pageSize;
+            }
+        }
+
+        /* No read into this buffer is outstanding */
+        if (ring->numCompleted == ring->numInFlight)
+            return 0;
+
+        uringReap(ring, 1);
+    }
+}
+
+int8_t URING_READ(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    return pread(fileInfo->fd, buffer, pageSize, (off_t)pageNum * pageSize) == (ssize_t)pageSize;
+}
+
+int8_t URING_WRITE(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    return pwrite(fileInfo->fd, buffer, pageSize, (off_t)pageNum * pageSize) == (ssize_t)pageSize;
+}
+
+int8_t URING_READ_PAGES(void **buffers, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    return readPagesVectored(fileInfo->fd, buffers, pageNum, numPages, pageSize);
+}
+
+int8_t URING_ERASE(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
+    return 1;
+}
+
+int8_t URING_FLUSH(void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    return fdatasync(fileInfo->fd) == 0;
+}
+
+int8_t URING_CLOSE(void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    if (fileInfo->fd == -1)
+        return 1;
+
+    URING *ring = fileInfo->ring;
+    if (ring != NULL) {
+        /* The kernel may still be writing into buffers of outstanding reads */
+        while (ring->numCompleted < ring->numInFlight) {
+            uringReap(ring, 1);
+        }
+        uringTearDown(ring);
+        fileInfo->ring = NULL;
+    }
+
+    close(fileInfo->fd);
+    fileInfo->fd = -1;
+    return 1;
+}
+
+int8_t URING_OPEN(void *file, uint8_t mode) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+
+    if (mode == EMBEDDB_FILE_MODE_W_PLUS_B) {
+        fileInfo->fd = open(fileInfo->filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    } else if (mode == EMBEDDB_FILE_MODE_R_PLUS_B) {
+        fileInfo->fd = open(fileInfo->filename, O_RDWR);
+    } else {
+        return 0;
+    }
+
+    if (fileInfo->fd == -1)
+        return 0;
+
+    /* Without io_uring, submitRead declines every read and embedDB reads synchronously */
+    fileInfo->isMapped = 0;
+    fileInfo->ring = uringSetup();
+    return 1;
+}
+
+embedDBFileInterface *getAsyncFileInterface() {
+    embedDBFileInterface *fileInterface = calloc(1, sizeof(embedDBFileInterface));
+    fileInterface->close = URING_CLOSE;
+    fileInterface->read = URING_READ;
+    fileInterface->write = URING_WRITE;
+    fileInterface->erase = URING_ERASE;
+    fileInterface->open = URING_OPEN;
+    fileInterface->flush = URING_FLUSH;
+    fileInterface->readPages = URING_READ_PAGES;
+    fileInterface->submitRead = URING_SUBMIT_READ;
+    fileInterface->waitRead = URING_WAIT_READ;
+    return fileInterface;
+}
+
+#endif
+
+#if defined(DESKTOP_FILE_INTERFACE_BACKGROUND_WRITER_SUPPORTED)
+
+/**
+ * @brief	Writes queued pages in the order they were queued until told to stop. A page stays in the queue until it is written
+ * 			so reads of it can be answered from the queue.
+ */
+static void *backgroundWriterRun(void *arg) {
+    BACKGROUND_WRITER *writer = (BACKGROUND_WRITER *)arg;
+    pthread_mutex_lock(&writer->lock);
+    while (1) {
+        while (writer->count == 0 && !writer->stop) {
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        }
+        if (writer->count == 0)
+            break;
+
+        /* Only this thread removes pages, so the slot is not reused while it is written without the lock */
+        uint8_t *page = writer->pages + (size_t)writer->head * writer->pageSize;
+        off_t offset = (off_t)writer->pageNums[writer->head] * writer->pageSize;
+        uint32_t pageSize = writer->pageSize;
+        pthread_mutex_unlock(&writer->lock);
+
+        int8_t success = pwrite(writer->fd, page, pageSize, offset) == (ssize_t)pageSize;
+
+        pthread_mutex_lock(&writer->lock);
+        if (!success)
+            writer->failed = 1;
+        writer->head = (writer->head + 1) % BACKGROUND_WRITER_QUEUE_DEPTH;
+        writer->count--;
+        pthread_cond_broadcast(&writer->changed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+/**
+ * @brief	Blocks until the writer thread has written every queued page. Must be called with the writer lock held.
+ */
+static void backgroundWriterDrain(BACKGROUND_WRITER *writer) {
+    while (writer->count > 0) {
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+}
+
+/**
+ * @brief	Copies the newest queued version of a page into buffer. Must be called with the writer lock held.
+ * @return	1 if the page is queued and 0 otherwise
+ */
+static int8_t backgroundWriterFind(BACKGROUND_WRITER *writer, void *buffer, uint32_t pageNum) {
+    for (uint32_t i = writer->count; i > 0; i--) {
+        uint32_t slot = (writer->head + i - 1) % BACKGROUND_WRITER_QUEUE_DEPTH;
+        if (writer->pageNums[slot] == pageNum) {
+            memcpy(buffer, writer->pages + (size_t)slot * writer->pageSize, writer->pageSize);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int8_t BACKGROUND_READ(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    BACKGROUND_WRITER *writer = fileInfo->writer;
+    if (writer != NULL) {
+        pthread_mutex_lock(&writer->lock);
+        int8_t found = backgroundWriterFind(writer, buffer, pageNum);
+        pthread_mutex_unlock(&writer->lock);
+
+        /* A page that is no longer queued has already been written, so the file has its newest version */
+        if (found)
+            return 1;
+    }
+    return pread(fileInfo->fd, buffer, pageSize, (off_t)pageNum * pageSize) == (ssize_t)pageSize;
+}
+
+int8_t BACKGROUND_WRITE(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    BACKGROUND_WRITER *writer = fileInfo->writer;
+    if (writer == NULL)
+        return pwrite(fileInfo->fd, buffer, pageSize, (off_t)pageNum * pageSize) == (ssize_t)pageSize;
+
+    pthread_mutex_lock(&writer->lock);
+    if (writer->pages == NULL || writer->pageSize != pageSize) {
+        /* Queued pages must all be the same size, so write out any of the old size before resizing */
+        backgroundWriterDrain(writer);
+        free(writer->pages);
+        writer->pages = malloc((size_t)BACKGROUND_WRITER_QUEUE_DEPTH * pageSize);
+        writer->pageSize = pageSize;
+        if (writer->pages == NULL) {
+            pthread_mutex_unlock(&writer->lock);
+            return 0;
+        }
+    }
+
+    while (writer->count == BACKGROUND_WRITER_QUEUE_DEPTH) {
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+
+    uint32_t slot = (writer->head + writer->count) % BACKGROUND_WRITER_QUEUE_DEPTH;
+    memcpy(writer->pages + (size_t)slot * pageSize, buffer, pageSize);
+    writer->pageNums[slot] = pageNum;
+    writer->count++;
+    pthread_cond_broadcast(&writer->changed);
+
+    /* Report a failed earlier write as soon as possible instead of waiting for the next flush */
+    int8_t success = !writer->failed;
+    pthread_mutex_unlock(&writer->lock);
+    return success;
+}
+
+int8_t BACKGROUND_READ_PAGES(void **buffers, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    BACKGROUND_WRITER *writer = fileInfo->writer;
+    if (writer != NULL) {
+        /* Pages still queued are not in the file yet, so fall back to reading one page at a time */
+        pthread_mutex_lock(&writer->lock);
+        uint8_t anyQueued = 0;
+        for (uint32_t i = 0; i < writer->count && !anyQueued; i++) {
+            uint32_t queuedPage = writer->pageNums[(writer->head + i) % BACKGROUND_WRITER_QUEUE_DEPTH];
+            anyQueued = queuedPage >= pageNum && queuedPage < pageNum + numPages;
+        }
+        pthread_mutex_unlock(&writer->lock);
+
+        if (anyQueued) {
+            for (uint32_t i = 0; i < numPages; i++) {
+                if (!BACKGROUND_READ(buffers[i], pageNum + i, pageSize, file))
+                    return 0;
+            }
+            return 1;
+        }
+    }
+    return readPagesVectored(fileInfo->fd, buffers, pageNum, numPages, pageSize);
+}
+
+int8_t BACKGROUND_ERASE(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
+    return 1;
+}
+
+int8_t BACKGROUND_FLUSH(void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    BACKGROUND_WRITER *writer = fileInfo->writer;
+    int8_t success = 1;
+    if (writer != NULL) {
+        pthread_mutex_lock(&writer->lock);
+        backgroundWriterDrain(writer);
+        success = !writer->failed;
+        writer->failed = 0;
+        pthread_mutex_unlock(&writer->lock);
+    }
+    return fdatasync(fileInfo->fd) == 0 && success;
+}
+
+int8_t BACKGROUND_CLOSE(void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    BACKGROUND_WRITER *writer = fileInfo->writer;
+    int8_t success = 1;
+    if (writer != NULL) {
+        /* The writer thread writes every queued page before it exits */
+        pthread_mutex_lock(&writer->lock);
+        writer->stop = 1;
+        pthread_cond_broadcast(&writer->changed);
+        pthread_mutex_unlock(&writer->lock);
+        pthread_join(writer->thread, NULL);
+
+        success = !writer->failed;
+        pthread_cond_destroy(&writer->changed);
+        pthread_mutex_destroy(&writer->lock);
+        free(writer->pages);
+        free(writer);
+        fileInfo->writer = NULL;
+    }
+
+    if (fileInfo->fd != -1) {
+        close(fileInfo->fd);
+        fileInfo->fd = -1;
+    }
+    return success;
+}
+
+int8_t BACKGROUND_OPEN(void *file, uint8_t mode) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+
+    if (mode == EMBEDDB_FILE_MODE_W_PLUS_B) {
+        fileInfo->fd = open(fileInfo->filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    } else if (mode == EMBEDDB_FILE_MODE_R_PLUS_B) {
+        fileInfo->fd = open(fileInfo->filename, O_RDWR);
+    } else {
+        return 0;
+    }
+
+    if (fileInfo->fd == -1)
+        return 0;
+
+    fileInfo->isMapped = 0;
+#if defined(DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED)
+    fileInfo->ring = NULL;
+#endif
+
+    /* Without a writer thread, pages are written before BACKGROUND_WRITE returns */
+    BACKGROUND_WRITER *writer = calloc(1, sizeof(BACKGROUND_WRITER));
+    if (writer == NULL)
+        return 1;
+
+    writer->fd = fileInfo->fd;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->changed, NULL);
+    if (pthread_create(&writer->thread, NULL, backgroundWriterRun, writer) != 0) {
+        pthread_cond_destroy(&writer->changed);
+        pthread_mutex_destroy(&writer->lock);
+        free(writer);
+        return 1;
+    }
+    fileInfo->writer = writer;
+    return 1;
+}
+
+embedDBFileInterface *getBackgroundFileInterface() {
+    embedDBFileInterface *fileInterface = calloc(1, sizeof(embedDBFileInterface));
+    fileInterface->close = BACKGROUND_CLOSE;
+    fileInterface->read = BACKGROUND_READ;
+    fileInterface->write = BACKGROUND_WRITE;
+    fileInterface->erase = BACKGROUND_ERASE;
+    fileInterface->open = BACKGROUND_OPEN;
+    fileInterface->flush = BACKGROUND_FLUSH;
+    fileInterface->readPages = BACKGROUND_READ_PAGES;
+    fileInterface->submitRead = NULL;
+    fileInterface->waitRead = NULL;
+    return fileInterface;
+}
+
+#endif
+
 embedDBFileInterface *getFileInterface() {
-    embedDBFileInterface *fileInterface = malloc(sizeof(embedDBFileInterface));
+#if defined(DESKTOP_FILE_INTERFACE_USE_ASYNC) && defined(DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED)
+    return getAsyncFileInterface();
+#elif defined(DESKTOP_FILE_INTERFACE_USE_BACKGROUND_WRITER) && defined(DESKTOP_FILE_INTERFACE_BACKGROUND_WRITER_SUPPORTED)
+    return getBackgroundFileInterface();
+#elif defined(DESKTOP_FILE_INTERFACE_USE_MMAP) && defined(DESKTOP_FILE_INTERFACE_MMAP_SUPPORTED)
+    return getMmapFileInterface();
+#else
+    embedDBFileInterface *fileInterface = calloc(1, sizeof(embedDBFileInterface));
     fileInterface->close = FILE_CLOSE;
     fileInterface->read = FILE_READ;
     fileInterface->write = FILE_WRITE;
     fileInterface->erase = FILE_ERASE;
     fileInterface->open = FILE_OPEN;
     fileInterface->flush = FILE_FLUSH;
+#if defined(DESKTOP_FILE_INTERFACE_VECTORED_IO_SUPPORTED)
+    fileInterface->readPages = FILE_READ_PAGES;
+#else
+    fileInterface->readPages = NULL;
+#endif
+    fileInterface->submitRead = NULL;
+    fileInterface->waitRead = NULL;
     return fileInterface;
+#endif
 }
 
 embedDBFileInterface *getMockEraseFileInterface() {
-    embedDBFileInterface *fileInterface = malloc(sizeof(embedDBFileInterface));
+    embedDBFileInterface *fileInterface = calloc(1, sizeof(embedDBFileInterface));
     fileInterface->close = FILE_CLOSE;
     fileInterface->read = FILE_READ;
     fileInterface->write = FILE_WRITE;
     fileInterface->erase = MOCK_FILE_ERASE;
     fileInterface->open = FILE_OPEN;
     fileInterface->flush = FILE_FLUSH;
+#if defined(DESKTOP_FILE_INTERFACE_VECTORED_IO_SUPPORTED)
+    fileInterface->readPages = FILE_READ_PAGES;
+#else
+    fileInterface->readPages = NULL;
+#endif
+    fileInterface->submitRead = NULL;
+    fileInterface->waitRead = NULL;
     return fileInterface;
 }
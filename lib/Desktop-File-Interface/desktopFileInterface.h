@@ -14,9 +14,34 @@ extern "C" {
 #include "../../src/embedDB/embedDB.h"
 #endif
 
+/* The memory-mapped interface needs POSIX mmap. Define DESKTOP_FILE_INTERFACE_USE_MMAP to have getFileInterface() return it */
+#if !defined(_WIN32) && !defined(ARDUINO)
+#define DESKTOP_FILE_INTERFACE_MMAP_SUPPORTED
+/* Multi-page reads use POSIX preadv */
+#define DESKTOP_FILE_INTERFACE_VECTORED_IO_SUPPORTED
+/* The background writer interface needs POSIX threads. Define DESKTOP_FILE_INTERFACE_USE_BACKGROUND_WRITER to have getFileInterface() return it */
+#define DESKTOP_FILE_INTERFACE_BACKGROUND_WRITER_SUPPORTED
+#endif
+
+/* The asynchronous interface needs Linux io_uring. Define DESKTOP_FILE_INTERFACE_USE_ASYNC to have getFileInterface() return it */
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED
+#endif
+#endif
+
 /* File functions */
 embedDBFileInterface *getFileInterface();
 embedDBFileInterface *getMockEraseFileInterface();
+#if defined(DESKTOP_FILE_INTERFACE_MMAP_SUPPORTED)
+embedDBFileInterface *getMmapFileInterface();
+#endif
+#if defined(DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED)
+embedDBFileInterface *getAsyncFileInterface();
+#endif
+#if defined(DESKTOP_FILE_INTERFACE_BACKGROUND_WRITER_SUPPORTED)
+embedDBFileInterface *getBackgroundFileInterface();
+#endif
 void *setupFile(char *filename);
 void tearDownFile(void *file);
 
@@ -167,6 +167,123 @@ void buildBitmapInt16FromRange(void *min, void *max, void *bm) {
     }
 }
 
+/*
+ * A range-encoded 16-bit bitmap on a 32-bit int value, for use with EMBEDDB_USE_RANGE_BITMAP.
+ * Uses the same temperature range as updateBitmapInt16 with 8 thresholds. The high byte has bit (15 - i) set if
+ * the value is <= threshold i and the low byte has bit (7 - i) set if it is > threshold i, so a page bitmap
+ * has the thresholds at or above its min set in the high byte and the thresholds below its max set in the low byte.
+ */
+#define INT16_RANGE_NUM_THRESHOLDS 8
+#define INT16_RANGE_MIN_THRESHOLD 320
+#define INT16_RANGE_STEP 60
+
+void updateBitmapInt16Range(void *data, void *bm) {
+    int32_t val = *((int32_t *)data);
+    uint16_t *bmval = (uint16_t *)bm;
+
+    int32_t threshold = INT16_RANGE_MIN_THRESHOLD;
+    for (int8_t i = 0; i < INT16_RANGE_NUM_THRESHOLDS; i++) {
+        if (val <= threshold)
+            *bmval = *bmval | (uint16_t)(32768 >> i);
+        else
+            *bmval = *bmval | (uint16_t)(128 >> i);
+        threshold += INT16_RANGE_STEP;
+    }
+}
+
+/**
+ * @brief	Builds a range-encoded 16-bit bitmap from (min, max) range. Sets at most one bit in each byte:
+ * 			the first threshold at or above max in the high byte and the last threshold below min in the low byte.
+ * @param	min		minimum value (may be NULL)
+ * @param	max		maximum value (may be NULL)
+ * @param	bm		bitmap created
+ */
+void buildBitmapInt16RangeFromRange(void *min, void *max, void *bm) {
+    uint16_t map = 0;
+    int32_t threshold = INT16_RANGE_MIN_THRESHOLD;
+    for (int8_t i = 0; i < INT16_RANGE_NUM_THRESHOLDS; i++) {
+        /* A page with a value <= max has its min at or below every threshold at or above max */
+        if (max != NULL && *((int32_t *)max) <= threshold && (map & 0xFF00) == 0)
+            map = map | (uint16_t)(32768 >> i);
+        /* A page with a value >= min has its max above every threshold below min */
+        if (min != NULL && *((int32_t *)min) > threshold)
+            map = (map & 0xFF00) | (uint16_t)(128 >> i);
+        threshold += INT16_RANGE_STEP;
+    }
+    *(uint16_t *)bm = map;
+}
+
+int8_t inBitmapInt16Range(void *data, void *bm) {
+    uint16_t *bmval = (uint16_t *)bm;
+
+    uint16_t tmpbm = 0;
+    updateBitmapInt16Range(data, &tmpbm);
+
+    /* Every byte the query sets bits in must overlap */
+    if ((*bmval & 0xFF00) != 0 && (tmpbm & *bmval & 0xFF00) == 0)
+        return 0;
+    if ((*bmval & 0x00FF) != 0 && (tmpbm & *bmval & 0x00FF) == 0)
+        return 0;
+    return 1;
+}
+
+/*
+ * A range-encoded 32-bit bitmap on a 32-bit int value, for use with EMBEDDB_USE_RANGE_BITMAP.
+ * Has 16 thresholds at the same step as the buckets of updateBitmapInt16. The high half has bit (31 - i) set if
+ * the value is <= threshold i and the low half has bit (15 - i) set if it is > threshold i.
+ */
+#define INT32_RANGE_NUM_THRESHOLDS 16
+#define INT32_RANGE_MIN_THRESHOLD 320
+#define INT32_RANGE_STEP 30
+
+void updateBitmapInt32Range(void *data, void *bm) {
+    int32_t val = *((int32_t *)data);
+    uint32_t *bmval = (uint32_t *)bm;
+
+    int32_t threshold = INT32_RANGE_MIN_THRESHOLD;
+    for (int8_t i = 0; i < INT32_RANGE_NUM_THRESHOLDS; i++) {
+        if (val <= threshold)
+            *bmval = *bmval | ((uint32_t)0x80000000 >> i);
+        else
+            *bmval = *bmval | ((uint32_t)0x8000 >> i);
+        threshold += INT32_RANGE_STEP;
+    }
+}
+
+/**
+ * @brief	Builds a range-encoded 32-bit bitmap from (min, max) range. Sets at most one bit in each half:
+ * 			the first threshold at or above max in the high half and the last threshold below min in the low half.
+ * @param	min		minimum value (may be NULL)
+ * @param	max		maximum value (may be NULL)
+ * @param	bm		bitmap created
+ */
+void buildBitmapInt32RangeFromRange(void *min, void *max, void *bm) {
+    uint32_t map = 0;
+    int32_t threshold = INT32_RANGE_MIN_THRESHOLD;
+    for (int8_t i = 0; i < INT32_RANGE_NUM_THRESHOLDS; i++) {
+        if (max != NULL && *((int32_t *)max) <= threshold && (map & 0xFFFF0000) == 0)
+            map = map | ((uint32_t)0x80000000 >> i);
+        if (min != NULL && *((int32_t *)min) > threshold)
+            map = (map & 0xFFFF0000) | ((uint32_t)0x8000 >> i);
+        threshold += INT32_RANGE_STEP;
+    }
+    *(uint32_t *)bm = map;
+}
+
+int8_t inBitmapInt32Range(void *data, void *bm) {
+    uint32_t *bmval = (uint32_t *)bm;
+
+    uint32_t tmpbm = 0;
+    updateBitmapInt32Range(data, &tmpbm);
+
+    /* Every half the query sets bits in must overlap */
+    if ((*bmval & 0xFFFF0000) != 0 && (tmpbm & *bmval & 0xFFFF0000) == 0)
+        return 0;
+    if ((*bmval & 0x0000FFFF) != 0 && (tmpbm & *bmval & 0x0000FFFF) == 0)
+        return 0;
+    return 1;
+}
+
 /* A 64-bit bitmap on a 32-bit int value */
 void updateBitmapInt64(void *data, void *bm) {
     int32_t val = *((int32_t *)data);
@@ -53,6 +53,12 @@ int8_t inBitmapInt8(void *data, void *bm);
 void updateBitmapInt16(void *data, void *bm);
 int8_t inBitmapInt16(void *data, void *bm);
 void buildBitmapInt16FromRange(void *min, void *max, void *bm);
+void updateBitmapInt16Range(void *data, void *bm);
+int8_t inBitmapInt16Range(void *data, void *bm);
+void buildBitmapInt16RangeFromRange(void *min, void *max, void *bm);
+void updateBitmapInt32Range(void *data, void *bm);
+int8_t inBitmapInt32Range(void *data, void *bm);
+void buildBitmapInt32RangeFromRange(void *min, void *max, void *bm);
 void updateBitmapInt64(void *data, void *bm);
 int8_t inBitmapInt64(void *data, void *bm);
 void buildBitmapInt64FromRange(void *min, void *max, void *bm);
@@ -127,12 +127,15 @@ int8_t FILE_OPEN(void *file, uint8_t mode) {
 }
 
 embedDBFileInterface *getSDInterface() {
-    embedDBFileInterface *fileInterface = malloc(sizeof(embedDBFileInterface));
+    embedDBFileInterface *fileInterface = calloc(1, sizeof(embedDBFileInterface));
     fileInterface->close = FILE_CLOSE;
     fileInterface->read = FILE_READ;
     fileInterface->write = FILE_WRITE;
     fileInterface->erase = FILE_ERASE;
     fileInterface->open = FILE_OPEN;
     fileInterface->flush = FILE_FLUSH;
+    fileInterface->readPages = NULL;
+    fileInterface->submitRead = NULL;
+    fileInterface->waitRead = NULL;
     return fileInterface;
 }
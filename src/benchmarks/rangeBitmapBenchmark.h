@@ -0,0 +1,265 @@
+/******************************************************************************/
+/**
+ * @file        rangeBitmapBenchmark.h
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       This file compares how many data pages range queries on the
+ *              temperature datasets read with equality-encoded and range-encoded bitmaps.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#ifndef PIO_UNIT_TESTING
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+
+#ifdef ARDUINO
+
+#include "SDFileInterface.h"
+#define FILE_TYPE SD_FILE
+#define fopen sd_fopen
+#define fread sd_fread
+#define fclose sd_fclose
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define SEA_DATASET_PATH "data/sea100K.bin"
+#define UWA_DATASET_PATH "data/uwa500K_only_100K.bin"
+
+#else
+
+#include "desktopFileInterface.h"
+#define FILE_TYPE FILE
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define SEA_DATASET_PATH "data/sea100K.bin"
+#define UWA_DATASET_PATH "data/uwa500K_only_100K.bin"
+
+#endif
+
+/* Dataset pages hold 16 byte records after a 16 byte header: a 4 byte timestamp key, then the temperature (F scaled by 10), humidity and wind speed */
+#define DATASET_PAGE_SIZE 512
+#define DATASET_HEADER_SIZE 16
+
+#define NUM_RANGE_DATASETS 2
+static const char *rangeDatasetNames[NUM_RANGE_DATASETS] = {"Seattle", "UWA"};
+static const char *rangeDatasetPaths[NUM_RANGE_DATASETS] = {SEA_DATASET_PATH, UWA_DATASET_PATH};
+
+/* Temperature predicates. A NULL bound is open-ended */
+#define NUM_RANGE_QUERIES 6
+static const int32_t rangeQueryMin[NUM_RANGE_QUERIES] = {700, 0, 0, 450, 550, 380};
+static const int32_t rangeQueryMax[NUM_RANGE_QUERIES] = {0, 350, 420, 500, 560, 620};
+static const int8_t rangeQueryHasMin[NUM_RANGE_QUERIES] = {1, 0, 0, 1, 1, 1};
+static const int8_t rangeQueryHasMax[NUM_RANGE_QUERIES] = {0, 1, 1, 1, 1, 1};
+
+/**
+ * 0 = 16 equality buckets at a step of 30 in a 2 byte bitmap
+ * 1 = 8 range thresholds at a step of 60 in a 2 byte bitmap
+ * 2 = 16 range thresholds at a step of 30 in a 4 byte bitmap, the same resolution as the equality buckets
+ */
+#define NUM_BITMAP_ENCODINGS 3
+static const char *bitmapEncodingNames[NUM_BITMAP_ENCODINGS] = {"Equality", "Range16", "Range32"};
+
+embedDBState *setupRangeBitmapState(int8_t encoding) {
+    embedDBState *state = (embedDBState *)malloc(sizeof(embedDBState));
+    if (state == NULL) {
+        printf("Unable to allocate state. Exiting.\n");
+        return NULL;
+    }
+
+    state->keySize = 4;
+    state->dataSize = 12;
+    state->pageSize = 512;
+    state->numSplinePoints = 300;
+    state->bitmapSize = encoding == 2 ? 4 : 2;
+    state->bufferSizeInBlocks = 4;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    if (state->buffer == NULL) {
+        printf("Unable to allocate buffer. Exiting.\n");
+        free(state);
+        return NULL;
+    }
+
+    state->numDataPages = 10000;
+    state->numIndexPages = 100;
+    state->eraseSizeInPages = 4;
+
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_FILE_PATH);
+    state->indexFile = setupFile(INDEX_FILE_PATH);
+
+    state->parameters = EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP | EMBEDDB_RESET_DATA;
+    if (encoding == 1) {
+        state->parameters |= EMBEDDB_USE_RANGE_BITMAP;
+        state->inBitmap = inBitmapInt16Range;
+        state->updateBitmap = updateBitmapInt16Range;
+        state->buildBitmapFromRange = buildBitmapInt16RangeFromRange;
+    } else if (encoding == 2) {
+        state->parameters |= EMBEDDB_USE_RANGE_BITMAP;
+        state->inBitmap = inBitmapInt32Range;
+        state->updateBitmap = updateBitmapInt32Range;
+        state->buildBitmapFromRange = buildBitmapInt32RangeFromRange;
+    } else {
+        state->inBitmap = inBitmapInt16;
+        state->updateBitmap = updateBitmapInt16;
+        state->buildBitmapFromRange = buildBitmapInt16FromRange;
+    }
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+
+    if (embedDBInit(state, 1) != 0) {
+        printf("Initialization error.\n");
+        tearDownFile(state->dataFile);
+        tearDownFile(state->indexFile);
+        free(state->buffer);
+        free(state->fileInterface);
+        free(state);
+        return NULL;
+    }
+    return state;
+}
+
+void tearDownRangeBitmapState(embedDBState *state) {
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+}
+
+/**
+ * Inserts every record of a dataset file.
+ * Returns 0 if success, -1 if the file could not be read or a record could not be inserted.
+ */
+int8_t loadRangeDataset(embedDBState *state, const char *path) {
+    FILE_TYPE *infile = fopen(path, "r+b");
+    if (infile == NULL) {
+        printf("Unable to open %s.\n", path);
+        return -1;
+    }
+
+    char infileBuffer[DATASET_PAGE_SIZE];
+    while (fread(infileBuffer, DATASET_PAGE_SIZE, 1, infile)) {
+        count_t count = EMBEDDB_GET_COUNT(infileBuffer);
+        for (count_t i = 0; i < count; i++) {
+            char *record = infileBuffer + DATASET_HEADER_SIZE + i * state->recordSize;
+            if (embedDBPut(state, record, record + state->keySize) != 0) {
+                printf("Error inserting record from %s.\n", path);
+                fclose(infile);
+                return -1;
+            }
+        }
+    }
+    fclose(infile);
+    return embedDBFlush(state);
+}
+
+/**
+ * Runs every query against the dataset with one bitmap encoding, recording the records returned and data pages read.
+ * Returns 0 if success, -1 if error.
+ */
+int8_t runRangeQueries(const char *path, int8_t encoding, uint32_t *records, uint32_t *reads, uint32_t *numPages) {
+    embedDBState *state = setupRangeBitmapState(encoding);
+    if (state == NULL)
+        return -1;
+    if (loadRangeDataset(state, path) != 0) {
+        tearDownRangeBitmapState(state);
+        return -1;
+    }
+    *numPages = state->nextDataPageId;
+
+    int8_t itData[12];
+    uint32_t itKey;
+    for (int8_t q = 0; q < NUM_RANGE_QUERIES; q++) {
+        int32_t minData = rangeQueryMin[q], maxData = rangeQueryMax[q];
+        embedDBIterator it;
+        it.minKey = NULL;
+        it.maxKey = NULL;
+        it.minData = rangeQueryHasMin[q] ? &minData : NULL;
+        it.maxData = rangeQueryHasMax[q] ? &maxData : NULL;
+
+        embedDBResetStats(state);
+        embedDBInitIterator(state, &it);
+        records[q] = 0;
+        while (embedDBNext(state, &it, &itKey, itData))
+            records[q]++;
+        embedDBCloseIterator(&it);
+        reads[q] = state->numReads;
+    }
+
+    tearDownRangeBitmapState(state);
+    return 0;
+}
+
+int runRangeBitmapBenchmark() {
+    printf("\nSTARTING EmbedDB RANGE BITMAP BENCHMARK.\n");
+    for (int8_t d = 0; d < NUM_RANGE_DATASETS; d++) {
+        uint32_t records[NUM_BITMAP_ENCODINGS][NUM_RANGE_QUERIES], reads[NUM_BITMAP_ENCODINGS][NUM_RANGE_QUERIES], numPages;
+        for (int8_t e = 0; e < NUM_BITMAP_ENCODINGS; e++) {
+            if (runRangeQueries(rangeDatasetPaths[d], e, records[e], reads[e], &numPages) != 0)
+                return -1;
+        }
+
+        printf("\n%s dataset, %lu data pages. Data pages read by encoding:\n", rangeDatasetNames[d], (unsigned long)numPages);
+        printf("%-16s %10s", "Temperature", "Records");
+        for (int8_t e = 0; e < NUM_BITMAP_ENCODINGS; e++)
+            printf(" %10s", bitmapEncodingNames[e]);
+        printf("\n");
+        for (int8_t q = 0; q < NUM_RANGE_QUERIES; q++) {
+            char predicate[32];
+            if (!rangeQueryHasMax[q]) {
+                snprintf(predicate, sizeof(predicate), ">= %li", (long)rangeQueryMin[q]);
+            } else if (!rangeQueryHasMin[q]) {
+                snprintf(predicate, sizeof(predicate), "<= %li", (long)rangeQueryMax[q]);
+            } else {
+                snprintf(predicate, sizeof(predicate), "%li to %li", (long)rangeQueryMin[q], (long)rangeQueryMax[q]);
+            }
+            printf("%-16s %10lu", predicate, (unsigned long)records[0][q]);
+            for (int8_t e = 0; e < NUM_BITMAP_ENCODINGS; e++) {
+                if (records[e][q] != records[0][q]) {
+                    printf("\nError: the encodings returned different records for %s.\n", predicate);
+                    return -1;
+                }
+                printf(" %10lu", (unsigned long)reads[e][q]);
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
+
+#endif
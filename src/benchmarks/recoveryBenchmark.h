@@ -0,0 +1,242 @@
+/******************************************************************************/
+/**
+ * @file        recoveryBenchmark.h
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       This file measures how long EmbedDB takes to start up from
+ *              existing files as more files are recovered, with each file interface.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#ifndef PIO_UNIT_TESTING
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+
+#define NUM_RUNS 5
+
+/* Number of data pages written before restarting. Every tenth record has variable data when the variable data file is used */
+#define NUM_DATA_PAGES 5000
+
+#ifdef ARDUINO
+
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+
+#define recoveryMicros micros
+#define DATA_FILE_PATH "dataFile.bin"
+#define INDEX_FILE_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+
+#else
+
+#include "desktopFileInterface.h"
+
+/* clock() measures CPU time, which leaves out the time spent waiting on reads, so startup is timed with a wall clock */
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+static uint32_t recoveryMicros() {
+    LARGE_INTEGER frequency, now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (uint32_t)(now.QuadPart / frequency.QuadPart * 1000000 + now.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+#else
+static uint32_t recoveryMicros() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+#endif
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+
+#endif
+
+/* The asynchronous interface overlaps the reads of the index and variable data files during recovery */
+#if defined(DESKTOP_FILE_INTERFACE_IO_URING_SUPPORTED)
+#define NUM_RECOVERY_INTERFACES 2
+static const char *recoveryInterfaceNames[NUM_RECOVERY_INTERFACES] = {"Standard", "Async"};
+static embedDBFileInterface *(*recoveryInterfaces[NUM_RECOVERY_INTERFACES])() = {getFileInterface, getAsyncFileInterface};
+#else
+#define NUM_RECOVERY_INTERFACES 1
+static const char *recoveryInterfaceNames[NUM_RECOVERY_INTERFACES] = {"Standard"};
+static embedDBFileInterface *(*recoveryInterfaces[NUM_RECOVERY_INTERFACES])() = {getFileInterface};
+#endif
+
+/* Each configuration recovers the files of the previous one plus one more. Each is timed as a whole startup, so the times are not additive */
+#define NUM_RECOVERY_CONFIGS 4
+static const char *recoveryConfigNames[NUM_RECOVERY_CONFIGS] = {"Data (binary search)", "Data and spline", "Data, spline, index", "Data, spline, index, var"};
+static const int16_t recoveryParameters[NUM_RECOVERY_CONFIGS] = {
+    EMBEDDB_USE_BINARY_SEARCH,
+    0,
+    EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP,
+    EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP | EMBEDDB_USE_VDATA};
+
+embedDBState *setupRecoveryState(int16_t parameters, embedDBFileInterface *(*getInterface)()) {
+    embedDBState *state = (embedDBState *)malloc(sizeof(embedDBState));
+    if (state == NULL) {
+        printf("Unable to allocate state. Exiting.\n");
+        return NULL;
+    }
+
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->numSplinePoints = 300;
+    state->bitmapSize = 1;
+    state->bufferSizeInBlocks = 8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    if (state->buffer == NULL) {
+        printf("Unable to allocate buffer. Exiting.\n");
+        free(state);
+        return NULL;
+    }
+
+    state->numDataPages = 20000;
+    state->numIndexPages = 1000;
+    state->numVarPages = 4000;
+    state->eraseSizeInPages = 4;
+
+    state->fileInterface = getInterface();
+    state->dataFile = setupFile(DATA_FILE_PATH);
+    state->indexFile = (parameters & EMBEDDB_USE_INDEX) ? setupFile(INDEX_FILE_PATH) : NULL;
+    state->varFile = (parameters & EMBEDDB_USE_VDATA) ? setupFile(VAR_DATA_FILE_PATH) : NULL;
+
+    state->parameters = parameters;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    return state;
+}
+
+void tearDownRecoveryState(embedDBState *state) {
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL)
+        tearDownFile(state->indexFile);
+    if (state->varFile != NULL)
+        tearDownFile(state->varFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+}
+
+/**
+ * Writes NUM_DATA_PAGES pages of records into new files with the given configuration and file interface, then restarts EmbedDB on them NUM_RUNS times.
+ * Returns the average startup time in microseconds, or -1 if there was an error.
+ */
+int32_t timeRecovery(int16_t parameters, embedDBFileInterface *(*getInterface)()) {
+    embedDBState *state = setupRecoveryState(parameters | EMBEDDB_RESET_DATA, getInterface);
+    if (state == NULL)
+        return -1;
+    if (embedDBInit(state, 1) != 0) {
+        printf("Initialization error.\n");
+        tearDownRecoveryState(state);
+        return -1;
+    }
+
+    char varData[] = "Variable data for the recovery benchmark";
+    for (int32_t key = 0; state->nextDataPageId < NUM_DATA_PAGES; key++) {
+        int32_t data = key % 100;
+        int8_t result;
+        if (EMBEDDB_USING_VDATA(parameters) && key % 10 == 0) {
+            result = embedDBPutVar(state, &key, &data, varData, sizeof(varData));
+        } else if (EMBEDDB_USING_VDATA(parameters)) {
+            result = embedDBPutVar(state, &key, &data, NULL, 0);
+        } else {
+            result = embedDBPut(state, &key, &data);
+        }
+
+        if (result != 0) {
+            printf("Error inserting record %li.\n", (long)key);
+            embedDBClose(state);
+            tearDownRecoveryState(state);
+            return -1;
+        }
+    }
+    embedDBFlush(state);
+    embedDBClose(state);
+
+    uint32_t totalTime = 0;
+    for (count_t r = 0; r < NUM_RUNS; r++) {
+        state->parameters = parameters;
+        uint32_t start = recoveryMicros();
+        int8_t result = embedDBInit(state, 1);
+        totalTime += recoveryMicros() - start;
+        if (result != 0) {
+            printf("Error restarting from existing files.\n");
+            tearDownRecoveryState(state);
+            return -1;
+        }
+        embedDBClose(state);
+    }
+
+    tearDownRecoveryState(state);
+    return totalTime / NUM_RUNS;
+}
+
+int runRecoveryBenchmark() {
+    printf("\nSTARTING EmbedDB RECOVERY BENCHMARK.\n");
+    int32_t times[NUM_RECOVERY_CONFIGS][NUM_RECOVERY_INTERFACES];
+    for (int8_t i = 0; i < NUM_RECOVERY_CONFIGS; i++) {
+        for (int8_t f = 0; f < NUM_RECOVERY_INTERFACES; f++) {
+            times[i][f] = timeRecovery(recoveryParameters[i], recoveryInterfaces[f]);
+            if (times[i][f] < 0)
+                return -1;
+        }
+    }
+
+    printf("\nStartup time in us by configuration and file interface with %d data pages (average of %d runs):\n", NUM_DATA_PAGES, NUM_RUNS);
+    printf("%-26s", "Files recovered");
+    for (int8_t f = 0; f < NUM_RECOVERY_INTERFACES; f++)
+        printf(" %10s", recoveryInterfaceNames[f]);
+    printf("\n");
+    for (int8_t i = 0; i < NUM_RECOVERY_CONFIGS; i++) {
+        printf("%-26s", recoveryConfigNames[i]);
+        for (int8_t f = 0; f < NUM_RECOVERY_INTERFACES; f++)
+            printf(" %10li", (long)times[i][f]);
+        printf("\n");
+    }
+    return 0;
+}
+
+#endif
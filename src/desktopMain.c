@@ -1,8 +1,8 @@
 #ifndef PIO_UNIT_TESTING
 
 /**
- * 0 - 2 are for benchmarks
- * 3 is for the example program
+ * 0 is for the example program
+ * 1 - 5 are for benchmarks
  *
  */
 #ifndef WHICH_PROGRAM
@@ -17,6 +17,10 @@
 #include "benchmarks/variableDataBenchmark.h"
 #elif WHICH_PROGRAM == 3
 #include "benchmarks/queryInterfaceBenchmark.h"
+#elif WHICH_PROGRAM == 4
+#include "benchmarks/recoveryBenchmark.h"
+#elif WHICH_PROGRAM == 5
+#include "benchmarks/rangeBitmapBenchmark.h"
 #endif
 
 int main() {
@@ -28,6 +32,10 @@ int main() {
     return test_vardata();
 #elif WHICH_PROGRAM == 3
     return advancedQueryExample();
+#elif WHICH_PROGRAM == 4
+    return runRecoveryBenchmark();
+#elif WHICH_PROGRAM == 5
+    return runRangeBitmapBenchmark();
 #endif
 }
 
@@ -48,22 +48,168 @@
 #include "serial_c_iface.h"
 #endif
 
+/* Number of key prefix bits indexed by a radix table over the spline points. 0 disables the radix table */
+#ifndef RADIX_BITS
+#define RADIX_BITS 0
+#endif
+
+/* Spline checkpoint header: checksum, then the spline fields, then lastKey, lower, upper and the first spline point */
+#define SPLINE_CHECKPOINT_NUM_FIELDS 10
+#define CHECKPOINT_HASH_BASIS 2166136261u
+
+/* Learned bitmap bucket page header: checksum, number of bucket boundaries and data size */
+#define BITMAP_BUCKETS_HEADER_SIZE (3 * sizeof(uint32_t))
+
+/* Index summary checkpoint header: checksum, next index page id, number of index pages and bitmap size. The summaries follow across as many pages as needed */
+#define INDEX_SUMMARY_HEADER_SIZE (4 * sizeof(uint32_t))
+#define INDEX_SUMMARY_SIZE(state) (sizeof(id_t) + (state)->bitmapSize)
+
+/* Superblock stored at the start of one of the two slots in the superblock file */
+typedef struct {
+    uint32_t sequence;         /* Incremented on every write. The valid slot with the highest sequence is used */
+    uint32_t pageSize;         /* Page size and file sizes the superblock was written with */
+    uint32_t numDataPages;
+    uint32_t numIndexPages;
+    uint32_t numVarPages;
+    uint32_t eraseSizeInPages;
+    id_t nextDataPageId;       /* Page ids of each file when the superblock was written */
+    id_t minDataPageId;
+    id_t nextIdxPageId;
+    id_t minIndexPageId;
+    id_t nextVarPageId;
+    uint32_t numAvailVarPages;
+    uint64_t minVarRecordId;
+    uint32_t checksum;         /* FNV-1a hash of the fields before it */
+} embedDBSuperblock;
+
+/* Binary search for the last page of a run of pages with consecutive logical page ids in one file */
+typedef struct {
+    int8_t (*readFn)(embedDBState *, id_t); /* Reads a page of the file into the read buffer of the file. NULL if the file is not being recovered */
+    void *file;
+    void *buffer;           /* Read buffer of the file */
+    id_t physicalPageId;    /* Physical page the run starts at */
+    id_t logicalPageId;     /* Logical page id of the page the run starts at */
+    id_t low;               /* The last page of the run is between low and high */
+    id_t high;
+} embedDBPageSearch;
+
+/* Index and variable data recovery each search for the last page written. The searches run together so their reads overlap */
+#define EMBEDDB_INDEX_SEARCH 0
+#define EMBEDDB_VAR_SEARCH 1
+#define EMBEDDB_NUM_RECOVERY_SEARCHES 2
+
 /* Helper Functions */
 int8_t embedDBInitData(embedDBState *state);
 int8_t embedDBInitDataFromFile(embedDBState *state);
 int8_t embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state);
-int8_t embedDBInitIndex(embedDBState *state);
-int8_t embedDBInitIndexFromFile(embedDBState *state);
-int8_t embedDBInitVarData(embedDBState *state);
-int8_t embedDBInitVarDataFromFile(embedDBState *state);
+int8_t embedDBInitBufferPools(embedDBState *state);
+int8_t embedDBInitStorage(embedDBState *state, size_t indexMaxError);
+void embedDBInitCleanup(embedDBState *state);
+int8_t embedDBInitIndex(embedDBState *state, embedDBPageSearch *search);
+int8_t embedDBInitIndexFromFile(embedDBState *state, embedDBPageSearch *search);
+int8_t embedDBFinishIndexFromFile(embedDBState *state, embedDBPageSearch *search);
+int8_t embedDBInitVarData(embedDBState *state, embedDBPageSearch *search);
+int8_t embedDBInitVarDataFromFile(embedDBState *state, embedDBPageSearch *search);
+int8_t embedDBFinishVarDataFromFile(embedDBState *state, embedDBPageSearch *search);
+int8_t embedDBFinishRecovery(embedDBState *state, embedDBPageSearch *searches);
+void initPageSearch(embedDBPageSearch *search, int8_t (*readFn)(embedDBState *, id_t), void *file, void *buffer, id_t physicalPageId, id_t logicalPageId, id_t numPages);
+void findLastConsecutivePages(embedDBState *state, embedDBPageSearch *searches, count_t numSearches);
+id_t findLastConsecutivePage(embedDBState *state, int8_t (*readFn)(embedDBState *, id_t), void *file, void *buffer, id_t physicalPageId, id_t logicalPageId, id_t numPages);
 int8_t shiftRecordLevelConsistencyBlocks(embedDBState *state);
 void embedDBInitSplineFromFile(embedDBState *state);
+void embedDBInitFencePointersFromFile(embedDBState *state);
+int8_t embedDBInitSplineFile(embedDBState *state);
+int8_t writeSplineCheckpoint(embedDBState *state);
+int8_t readSplineCheckpoint(embedDBState *state, id_t *checkpointPageId);
+int8_t embedDBInitSuperblockFile(embedDBState *state);
+int8_t writeSuperblock(embedDBState *state);
+int8_t readSuperblock(embedDBState *state, embedDBSuperblock *superblock);
+int8_t embedDBInitBitmapFile(embedDBState *state);
+int8_t writeBitmapBuckets(embedDBState *state);
+int8_t readBitmapBuckets(embedDBState *state);
+int8_t learnBitmapBuckets(embedDBState *state, void *sample, uint32_t numValues);
+int8_t embedDBInitSummaryFile(embedDBState *state);
+int8_t writeIndexSummaries(embedDBState *state);
+int8_t embedDBInitIndexSummaries(embedDBState *state);
+void updateIndexSummary(embedDBState *state, void *indexPage, id_t physicalPageNumber);
+int8_t findSummaryIndexPage(embedDBState *state, id_t pageId, id_t *indexPageId);
+id_t skipIndexPagesBySummary(embedDBState *state, void *queryBitmap, id_t pageId);
+int8_t recoverFromSuperblock(embedDBState *state, int8_t (*readFn)(embedDBState *, id_t), void *buffer, uint32_t numPages, id_t *minPageId, id_t *nextPageId);
+int8_t embedDBInitDataFromSuperblock(embedDBState *state, embedDBSuperblock *superblock);
+int8_t embedDBInitIndexFromSuperblock(embedDBState *state, embedDBSuperblock *superblock);
+int8_t embedDBInitVarDataFromSuperblock(embedDBState *state, embedDBSuperblock *superblock);
+int8_t embedDBPinIndexPages(embedDBState *state);
+int8_t writeCheckpoints(embedDBState *state);
 int32_t getMaxError(embedDBState *state, void *buffer);
 void updateMaxiumError(embedDBState *state, void *buffer);
 int8_t embedDBSetupVarDataStream(embedDBState *state, void *key, embedDBVarDataStream **varData, id_t recordNumber);
 uint32_t cleanSpline(embedDBState *state, uint32_t minPageNumber);
 void readToWriteBuf(embedDBState *state);
 void readToWriteBufVar(embedDBState *state);
+int32_t readPageFromFile(embedDBState *state, void *file, void *buffer, id_t pageNum, id_t lastPageNum, uint32_t numPages);
+void invalidateBufferedPages(embedDBState *state, void *file, id_t startPage, id_t endPage);
+int8_t initBufferPool(embedDBBufferPool *pool, void *pages, count_t numFrames);
+void closeBufferPool(embedDBBufferPool *pool);
+embedDBFrame *findFrame(embedDBBufferPool *pool, void *file, id_t pageNum);
+void cachePage(embedDBState *state, embedDBBufferPool *pool, void *file, id_t pageNum, void *buffer);
+int8_t submitPageRead(embedDBState *state, void *file, id_t pageNum);
+int8_t completePageRead(embedDBState *state, embedDBBufferPool *pool, embedDBFrame *frame);
+void waitForSubmittedReads(embedDBState *state);
+void prefetchDataPages(embedDBState *state, id_t startPage, id_t endPage);
+int8_t iteratorNextRecord(embedDBState *state, embedDBIterator *it, void *key, void *data);
+count_t indexPageCandidates(embedDBState *state, embedDBIterator *it, void *indexPage, id_t firstPageId, id_t startPageId, id_t *candidates, count_t maxCandidates);
+int8_t iteratorNextCandidatePage(embedDBState *state, embedDBIterator *it, id_t *pageId, id_t endPage);
+void prefetchIteratorPages(embedDBState *state, embedDBIterator *it);
+count_t readAheadDepth(embedDBState *state, embedDBBufferPool *pool);
+int8_t eraseNextDataBlock(embedDBState *state);
+int8_t eraseNextIndexBlock(embedDBState *state);
+int8_t eraseNextVarBlock(embedDBState *state);
+int8_t writeFullDataPage(embedDBState *state);
+void buildIndexRecord(embedDBState *state, void *buffer, void *indexRecord);
+int8_t findIndexPage(embedDBState *state, id_t pageId, void **indexPage, id_t *firstPageId);
+int8_t findIndexRecord(embedDBState *state, id_t pageId, void **indexRecord);
+void buildBloomFilter(embedDBState *state, void *buffer, void *filter);
+int8_t bloomFilterMayContain(embedDBState *state, id_t pageId, void *key);
+void *previousDataKey(embedDBState *state);
+void fitPageModel(embedDBState *state, void *buffer);
+int8_t pageModelSearchWindow(embedDBState *state, void *buffer, void *key, int16_t *first, int16_t *last);
+
+/* Key size as a constant when compiled for a key type, so copying a key is a single load and store */
+#if defined(EMBEDDB_KEY_TYPE)
+#define EMBEDDB_KEY_SIZE(state) sizeof(EMBEDDB_KEY_TYPE)
+#else
+#define EMBEDDB_KEY_SIZE(state) ((state)->keySize)
+#endif
+
+/**
+ * @brief	Compares two keys. Compiled inline when EMBEDDB_KEY_TYPE is defined, otherwise calls compareKey.
+ * @return	Negative if a < b, 0 if a == b, positive if a > b
+ */
+static inline int8_t embedDBCompareKeys(embedDBState *state, void *a, void *b) {
+#if defined(EMBEDDB_KEY_TYPE)
+    EMBEDDB_KEY_TYPE keyA, keyB;
+    memcpy(&keyA, a, sizeof(EMBEDDB_KEY_TYPE));
+    memcpy(&keyB, b, sizeof(EMBEDDB_KEY_TYPE));
+    return (keyA > keyB) - (keyA < keyB);
+#else
+    return state->compareKey(a, b);
+#endif
+}
+
+/**
+ * @brief	Compares two data values. Compiled inline when EMBEDDB_DATA_TYPE is defined, otherwise calls compareData.
+ * @return	Negative if a < b, 0 if a == b, positive if a > b
+ */
+static inline int8_t embedDBCompareData(embedDBState *state, void *a, void *b) {
+#if defined(EMBEDDB_DATA_TYPE)
+    EMBEDDB_DATA_TYPE dataA, dataB;
+    memcpy(&dataA, a, sizeof(EMBEDDB_DATA_TYPE));
+    memcpy(&dataB, b, sizeof(EMBEDDB_DATA_TYPE));
+    return (dataA > dataB) - (dataA < dataB);
+#else
+    return state->compareData(a, b);
+#endif
+}
 
 void printBitmap(char *bm) {
     for (int8_t i = 0; i <= 7; i++) {
@@ -84,6 +230,111 @@ int8_t bitmapOverlap(uint8_t *bm1, uint8_t *bm2, int8_t size) {
     return 0;
 }
 
+/**
+ * @brief	Determine if a page can match a query with range-encoded bitmaps, where each half of the bitmap is a separate set of thresholds.
+ * 			The page must overlap the query in every half the query sets bits in, so a range takes one probe for each end.
+ * @return	1 if the page may match, else 0
+ */
+int8_t rangeBitmapOverlap(uint8_t *query, uint8_t *bm, int8_t size) {
+    int8_t half = size / 2;
+    for (int8_t start = 0; start < size; start += half) {
+        uint8_t querySet = 0, overlap = 0;
+        for (int8_t i = start; i < start + half; i++) {
+            querySet |= query[i];
+            overlap |= query[i] & bm[i];
+        }
+        if (querySet != 0 && overlap == 0)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief	Determine if a page or index page summary bitmap can match a query bitmap, using the encoding the state was configured with.
+ * @return	1 if the page may match, else 0
+ */
+static inline int8_t pageBitmapMatches(embedDBState *state, void *queryBitmap, void *bm) {
+    if (EMBEDDB_USING_RANGE_BITMAP(state->parameters))
+        return rangeBitmapOverlap((uint8_t *)queryBitmap, (uint8_t *)bm, state->bitmapSize);
+    return bitmapOverlap((uint8_t *)queryBitmap, (uint8_t *)bm, state->bitmapSize);
+}
+
+/**
+ * @brief	Finds the learned bitmap bucket of a data value by binary search over the bucket boundaries.
+ * @return	Bucket of the value, from 0 to bitmapSize * 8 - 1
+ */
+static inline uint16_t learnedBitmapBucket(embedDBState *state, void *data) {
+    uint16_t first = 0, last = state->bitmapSize * 8 - 1;
+    while (first < last) {
+        uint16_t mid = (first + last) / 2;
+        if (embedDBCompareData(state, (int8_t *)state->bitmapBoundaries + (size_t)mid * state->dataSize, data) <= 0)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    return first;
+}
+
+/**
+ * @brief	Sets the bit of a data value in a bitmap, using the learned buckets with EMBEDDB_USE_LEARNED_BITMAP.
+ * 			Until the buckets are learned every bit is set so the page matches every query.
+ */
+static inline void embedDBUpdateBitmap(embedDBState *state, void *data, void *bm) {
+    if (!EMBEDDB_USING_LEARNED_BITMAP(state->parameters)) {
+        state->updateBitmap(data, bm);
+    } else if (!state->bitmapLearned) {
+        memset(bm, 0xFF, state->bitmapSize);
+    } else {
+        uint16_t bucket = learnedBitmapBucket(state, data);
+        ((uint8_t *)bm)[bucket / 8] |= 0x80 >> (bucket % 8);
+    }
+}
+
+/**
+ * @brief	Builds the bitmap of a data range, using the learned buckets with EMBEDDB_USE_LEARNED_BITMAP.
+ * @param	minData	Smallest data value in the range, or NULL for no lower bound
+ * @param	maxData	Largest data value in the range, or NULL for no upper bound
+ */
+static inline void embedDBBuildBitmapFromRange(embedDBState *state, void *minData, void *maxData, void *bm) {
+    if (!EMBEDDB_USING_LEARNED_BITMAP(state->parameters)) {
+        state->buildBitmapFromRange(minData, maxData, bm);
+        return;
+    }
+
+    if (!state->bitmapLearned) {
+        memset(bm, 0xFF, state->bitmapSize);
+        return;
+    }
+    memset(bm, 0, state->bitmapSize);
+    uint16_t firstBucket = minData == NULL ? 0 : learnedBitmapBucket(state, minData);
+    uint16_t lastBucket = maxData == NULL ? state->bitmapSize * 8 - 1 : learnedBitmapBucket(state, maxData);
+    for (uint16_t bucket = firstBucket; bucket <= lastBucket; bucket++)
+        ((uint8_t *)bm)[bucket / 8] |= 0x80 >> (bucket % 8);
+}
+
+int8_t embedDBInBitmap(embedDBState *state, void *data, void *bm) {
+    if (!EMBEDDB_USING_LEARNED_BITMAP(state->parameters))
+        return state->inBitmap(data, bm);
+    if (!state->bitmapLearned)
+        return 1;
+    uint16_t bucket = learnedBitmapBucket(state, data);
+    return (((uint8_t *)bm)[bucket / 8] & (0x80 >> (bucket % 8))) != 0;
+}
+
+/**
+ * @brief	Adds an inserted data value to the sample the bitmap buckets are learned from, learning them once the sample is full.
+ * @return	Return 0 if success. Non-zero value if the buckets could not be saved.
+ */
+static inline int8_t sampleBitmapValue(embedDBState *state, void *data) {
+    if (state->bitmapSample == NULL)
+        return 0;
+    memcpy((int8_t *)state->bitmapSample + (size_t)state->numBitmapSamples * state->dataSize, data, state->dataSize);
+    state->numBitmapSamples++;
+    if (state->numBitmapSamples < state->bitmapSampleSize)
+        return 0;
+    return learnBitmapBuckets(state, state->bitmapSample, state->numBitmapSamples);
+}
+
 void initBufferPage(embedDBState *state, int pageNum) {
     /* Initialize page */
     uint16_t i = 0;
@@ -144,6 +395,23 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
         return -1;
     }
 
+#if defined(EMBEDDB_KEY_TYPE)
+    if (state->keySize != sizeof(EMBEDDB_KEY_TYPE)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Key size does not match the key type embedDB was compiled for.\n");
+#endif
+        return -1;
+    }
+#endif
+#if defined(EMBEDDB_DATA_TYPE)
+    if (state->dataSize < sizeof(EMBEDDB_DATA_TYPE)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Data size is smaller than the data type embedDB was compiled for.\n");
+#endif
+        return -1;
+    }
+#endif
+
     /* check the number of allocated pages is a multiple of the erase size */
     if (state->numDataPages % state->eraseSizeInPages != 0) {
 #ifdef PRINT_ERRORS
@@ -168,10 +436,21 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
             return -1;
         }
         state->recordSize += 4;
+    } else {
+        /* Unused files have no pages. Set before any file is recovered, since readSuperblock compares the size of every file */
+        state->numVarPages = 0;
     }
 
     state->indexMaxError = indexMaxError;
 
+    if (EMBEDDB_USING_RANGE_BITMAP(state->parameters) &&
+        (!EMBEDDB_USING_BMAP(state->parameters) || EMBEDDB_USING_LEARNED_BITMAP(state->parameters) || state->bitmapSize % 2 != 0)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: EMBEDDB_USE_RANGE_BITMAP requires EMBEDDB_USE_BMAP and an even bitmap size, and cannot be used with EMBEDDB_USE_LEARNED_BITMAP.\n");
+#endif
+        return -1;
+    }
+
     /* Calculate block header size */
 
     /* Header size depends on bitmap size: 6 + X bytes: 4 byte id, 2 for record count, X for bitmap. */
@@ -184,16 +463,60 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
             return -1;
         }
         state->headerSize += state->bitmapSize;
+    } else {
+        state->numIndexPages = 0;
+    }
+
+    if (EMBEDDB_USING_MAX_MIN(state->parameters)) {
+        /* Min and max are stored at a fixed offset after the space reserved for an 8 byte bitmap */
+        if (state->headerSize > EMBEDDB_MIN_OFFSET) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: The bitmap size must be at most 8 bytes when storing the min and max in the page header.\n");
+#endif
+            return -1;
+        }
+        state->headerSize = EMBEDDB_MIN_OFFSET + state->keySize * 2 + state->dataSize * 2;
     }
 
-    if (EMBEDDB_USING_MAX_MIN(state->parameters))
-        state->headerSize += state->keySize * 2 + state->dataSize * 2;
+    if (EMBEDDB_USING_PAGE_MODEL(state->parameters))
+        state->headerSize += EMBEDDB_PAGE_MODEL_SIZE;
 
     /* Flags to show that these values have not been initalized with actual data yet */
     state->bufferedPageId = -1;
     state->bufferedIndexPageId = -1;
     state->bufferedVarPage = -1;
 
+    /* Cleared before anything is allocated, so a failed init frees only what it allocated */
+    state->spl = NULL;
+    state->fencePointers = NULL;
+    state->bitmapBoundaries = NULL;
+    state->bitmapSample = NULL;
+    state->indexSummaries = NULL;
+
+    if (embedDBInitBufferPools(state) != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to allocate buffer pool.\n");
+#endif
+        return -1;
+    }
+
+    int8_t storageResult = embedDBInitStorage(state, indexMaxError);
+    if (storageResult != 0) {
+        embedDBInitCleanup(state);
+        return storageResult;
+    }
+
+    embedDBResetStats(state);
+    return 0;
+}
+
+/**
+ * @brief	Sets up the page search structures and initializes or recovers each file. Called by embedDBInit once the buffer pools are allocated.
+ * @param	state			embedDB algorithm state structure
+ * @param	indexMaxError	Max error of the spline
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitStorage(embedDBState *state, size_t indexMaxError) {
     /* Calculate number of records per page */
     state->maxRecordsPerPage = (state->pageSize - state->headerSize) / state->recordSize;
 
@@ -211,7 +534,21 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
     }
 
     /* Initalize the spline structure if being used */
-    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+    if (EMBEDDB_USING_FENCE_POINTERS(state->parameters)) {
+        if (EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: EMBEDDB_USE_FENCE_POINTERS cannot be used with EMBEDDB_USE_BINARY_SEARCH.\n");
+#endif
+            return -1;
+        }
+        state->fencePointers = malloc((size_t)state->numDataPages * state->keySize);
+        if (state->fencePointers == NULL) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: Unable to allocate the fence pointers.\n");
+#endif
+            return -1;
+        }
+    } else if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
         if (state->numSplinePoints < 4) {
 #ifdef PRINT_ERRORS
             printf("ERROR: Unable to setup spline with less than 4 points.");
@@ -220,6 +557,48 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
         }
         state->spl = malloc(sizeof(spline));
         splineInit(state->spl, state->numSplinePoints, indexMaxError, state->keySize);
+#if RADIX_BITS > 0
+        if (splineInitRadix(state->spl, RADIX_BITS) != 0) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: Unable to allocate the radix table for the spline.\n");
+#endif
+            return -1;
+        }
+#endif
+    }
+
+    /* Open the spline checkpoint before recovery reads it */
+    if (EMBEDDB_PERSISTING_SPLINE(state->parameters)) {
+        int8_t splineFileResult = embedDBInitSplineFile(state);
+        if (splineFileResult != 0)
+            return splineFileResult;
+    } else {
+        state->splineFile = NULL;
+    }
+
+    if (EMBEDDB_USING_SUPERBLOCK(state->parameters)) {
+        int8_t superblockFileResult = embedDBInitSuperblockFile(state);
+        if (superblockFileResult != 0)
+            return superblockFileResult;
+    } else {
+        state->superblockFile = NULL;
+    }
+
+    /* Load the learned bitmap buckets before any page is written with them */
+    if (EMBEDDB_USING_LEARNED_BITMAP(state->parameters)) {
+        int8_t bitmapFileResult = embedDBInitBitmapFile(state);
+        if (bitmapFileResult != 0)
+            return bitmapFileResult;
+    } else {
+        state->bitmapFile = NULL;
+    }
+
+    if (EMBEDDB_USING_INDEX_SUMMARY(state->parameters)) {
+        int8_t summaryFileResult = embedDBInitSummaryFile(state);
+        if (summaryFileResult != 0)
+            return summaryFileResult;
+    } else {
+        state->summaryFile = NULL;
     }
 
     /* Allocate file for data*/
@@ -230,6 +609,10 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
         return dataInitResult;
     }
 
+    /* Files that are recovered by a scan fill in their search for the last page written */
+    embedDBPageSearch searches[EMBEDDB_NUM_RECOVERY_SEARCHES];
+    memset(searches, 0, sizeof(searches));
+
     /* Allocate file and buffer for index */
     int8_t indexInitResult = 0;
     if (EMBEDDB_USING_INDEX(state->parameters)) {
@@ -239,11 +622,22 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
 #endif
             return -1;
         } else {
-            indexInitResult = embedDBInitIndex(state);
+            indexInitResult = embedDBInitIndex(state, &searches[EMBEDDB_INDEX_SEARCH]);
         }
     } else {
+        if (EMBEDDB_USING_BLOOM_FILTER(state->parameters)) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: EMBEDDB_USE_BLOOM_FILTER stores the Bloom filters in the index and requires EMBEDDB_USE_INDEX.\n");
+#endif
+            return -1;
+        }
+        if (EMBEDDB_USING_ZONE_MAP(state->parameters)) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: EMBEDDB_USE_ZONE_MAP stores the zone maps in the index and requires EMBEDDB_USE_INDEX.\n");
+#endif
+            return -1;
+        }
         state->indexFile = NULL;
-        state->numIndexPages = 0;
     }
 
     if (indexInitResult != 0) {
@@ -259,15 +653,110 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
 #endif
             return -1;
         } else {
-            varDataInitResult = embedDBInitVarData(state);
+            varDataInitResult = embedDBInitVarData(state, &searches[EMBEDDB_VAR_SEARCH]);
         }
-        return varDataInitResult;
     } else {
         state->varFile = NULL;
-        state->numVarPages = 0;
     }
 
-    embedDBResetStats(state);
+    if (varDataInitResult != 0) {
+        return varDataInitResult;
+    }
+
+    return embedDBFinishRecovery(state, searches);
+}
+
+/**
+ * @brief	Frees what embedDBInit allocated before it failed. Structures that were not allocated yet are NULL.
+ * @param	state	embedDB algorithm state structure
+ */
+void embedDBInitCleanup(embedDBState *state) {
+    waitForSubmittedReads(state);
+    closeBufferPool(&state->dataPool);
+    if (state->indexPool.pinned) {
+        free(state->indexPool.pages);
+        state->indexPool.pages = NULL;
+    }
+    closeBufferPool(&state->indexPool);
+    if (state->spl != NULL) {
+        splineClose(state->spl);
+        free(state->spl);
+        state->spl = NULL;
+    }
+    free(state->fencePointers);
+    state->fencePointers = NULL;
+    free(state->bitmapBoundaries);
+    free(state->bitmapSample);
+    state->bitmapBoundaries = NULL;
+    state->bitmapSample = NULL;
+    free(state->indexSummaries);
+    state->indexSummaries = NULL;
+}
+
+/**
+ * @brief	Finishes recovering the index and variable data files once both have started, then builds the spline.
+ * 			The searches for the last page written in each file run together, so with a file interface that supports
+ * 			asynchronous reads a read from each file is in flight at the same time.
+ * @param	state		embedDB algorithm state structure
+ * @param	searches	Search for the last page written in the index and variable data files
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t embedDBFinishRecovery(embedDBState *state, embedDBPageSearch *searches) {
+    findLastConsecutivePages(state, searches, EMBEDDB_NUM_RECOVERY_SEARCHES);
+
+    if (searches[EMBEDDB_INDEX_SEARCH].readFn != NULL && embedDBFinishIndexFromFile(state, &searches[EMBEDDB_INDEX_SEARCH]) != 0)
+        return -1;
+    if (searches[EMBEDDB_VAR_SEARCH].readFn != NULL && embedDBFinishVarDataFromFile(state, &searches[EMBEDDB_VAR_SEARCH]) != 0)
+        return -1;
+    if (state->indexSummaries != NULL && embedDBInitIndexSummaries(state) != 0)
+        return -1;
+
+    /* The spline and fence pointers only depend on the data file, so they are built after the other files are recovered */
+    if (!EMBEDDB_RESETING_DATA(state->parameters) && state->nextDataPageId > 0) {
+        if (EMBEDDB_USING_SPLINE(state->parameters)) {
+            embedDBInitSplineFromFile(state);
+        } else if (EMBEDDB_USING_FENCE_POINTERS(state->parameters)) {
+            embedDBInitFencePointersFromFile(state);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief	Splits the buffer pages past the reserved ones between the data and index buffer pools.
+ * 			With EMBEDDB_PIN_INDEX the index pool is allocated separately and holds every index page.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t embedDBInitBufferPools(embedDBState *state) {
+    count_t numSpare = 0;
+    if (state->bufferSizeInBlocks > EMBEDDB_FIRST_FRAME_BUFFER(state->parameters))
+        numSpare = state->bufferSizeInBlocks - EMBEDDB_FIRST_FRAME_BUFFER(state->parameters);
+    void *sparePages = (int8_t *)state->buffer + (size_t)state->pageSize * EMBEDDB_FIRST_FRAME_BUFFER(state->parameters);
+
+    count_t numIndexFrames = 0;
+    void *indexPages = NULL;
+    if (EMBEDDB_USING_INDEX(state->parameters) && EMBEDDB_PINNING_INDEX(state->parameters)) {
+        if (state->numIndexPages >= EMBEDDB_NO_FRAME)
+            return -1;
+        numIndexFrames = state->numIndexPages;
+        indexPages = malloc((size_t)numIndexFrames * state->pageSize);
+        if (indexPages == NULL)
+            return -1;
+    } else if (EMBEDDB_USING_INDEX(state->parameters) && numSpare >= 2) {
+        /* Each index page covers many data pages, so a quarter of the pool is plenty. Leave at least one frame for data pages */
+        numIndexFrames = min((uint32_t)(numSpare + 3) / 4, state->numIndexPages);
+        indexPages = (int8_t *)sparePages + (size_t)state->pageSize * (numSpare - numIndexFrames);
+        numSpare -= numIndexFrames;
+    }
+
+    if (initBufferPool(&state->dataPool, sparePages, numSpare) != 0 || initBufferPool(&state->indexPool, indexPages, numIndexFrames) != 0) {
+        closeBufferPool(&state->dataPool);
+        if (EMBEDDB_PINNING_INDEX(state->parameters))
+            free(indexPages);
+        return -1;
+    }
+    state->indexPool.pinned = EMBEDDB_USING_INDEX(state->parameters) && EMBEDDB_PINNING_INDEX(state->parameters);
     return 0;
 }
 
@@ -297,9 +786,12 @@ int8_t embedDBInitData(embedDBState *state) {
         if (openStatus) {
             if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
                 return embedDBInitDataFromFileWithRecordLevelConsistency(state);
-            } else {
-                return embedDBInitDataFromFile(state);
             }
+            embedDBSuperblock superblock;
+            if (EMBEDDB_USING_SUPERBLOCK(state->parameters) && readSuperblock(state, &superblock) == 0 && embedDBInitDataFromSuperblock(state, &superblock) == 0) {
+                return 0;
+            }
+            return embedDBInitDataFromFile(state);
         }
     } else {
         openStatus = state->fileInterface->open(state->dataFile, EMBEDDB_FILE_MODE_W_PLUS_B);
@@ -315,6 +807,94 @@ int8_t embedDBInitData(embedDBState *state) {
     return 0;
 }
 
+/**
+ * @brief	Starts a search for the last page of a run of pages with consecutive logical page ids. Pages are written in order,
+ * 			so every page after the run is erased, never written or from the previous pass over the file, and the end of
+ * 			the run is found with a binary search that reads O(log n) pages instead of every page.
+ * @param	search			Search to start
+ * @param	readFn			Function that reads a page of the file into the read buffer of the file
+ * @param	file			File to search
+ * @param	buffer			Read buffer of the file
+ * @param	physicalPageId	Physical page the run starts at
+ * @param	logicalPageId	Logical page id of the page the run starts at
+ * @param	numPages		Number of pages in the file
+ */
+void initPageSearch(embedDBPageSearch *search, int8_t (*readFn)(embedDBState *, id_t), void *file, void *buffer, id_t physicalPageId, id_t logicalPageId, id_t numPages) {
+    search->readFn = readFn;
+    search->file = file;
+    search->buffer = buffer;
+    search->physicalPageId = physicalPageId;
+    search->logicalPageId = logicalPageId;
+    search->low = physicalPageId;
+    search->high = numPages - 1;
+}
+
+/**
+ * @brief	Runs searches for the last page of a run of consecutive pages in several files together. Each step submits the
+ * 			next read of every search before waiting on any of them, so the reads overlap if the file interface supports
+ * 			asynchronous reads. When the searches finish, low is the physical page id of the last page of each run.
+ * @param	state		embedDB algorithm state structure
+ * @param	searches	Searches to run. Searches with nothing left to search are skipped
+ * @param	numSearches	Number of searches
+ */
+void findLastConsecutivePages(embedDBState *state, embedDBPageSearch *searches, count_t numSearches) {
+    count_t numSearching = 0;
+    for (count_t i = 0; i < numSearches; i++) {
+        if (searches[i].low < searches[i].high)
+            numSearching++;
+    }
+
+    while (numSearching > 0) {
+        /* A single search would wait on its read straight away, so only submit reads when there is another to overlap with */
+        if (numSearching > 1) {
+            for (count_t i = 0; i < numSearches; i++) {
+                embedDBPageSearch *search = &searches[i];
+                if (search->low < search->high)
+                    submitPageRead(state, search->file, search->low + (search->high - search->low + 1) / 2);
+            }
+        }
+
+        numSearching = 0;
+        for (count_t i = 0; i < numSearches; i++) {
+            embedDBPageSearch *search = &searches[i];
+            if (search->low >= search->high)
+                continue;
+
+            id_t middle = search->low + (search->high - search->low + 1) / 2;
+            id_t middleLogicalPageId = 0;
+            bool readSuccess = search->readFn(state, middle) == 0;
+            if (readSuccess)
+                memcpy(&middleLogicalPageId, search->buffer, sizeof(id_t));
+            if (readSuccess && middleLogicalPageId == search->logicalPageId + (middle - search->physicalPageId)) {
+                search->low = middle;
+            } else {
+                search->high = middle - 1;
+            }
+
+            if (search->low < search->high)
+                numSearching++;
+        }
+    }
+}
+
+/**
+ * @brief	Finds the last page of a run of pages with consecutive logical page ids in one file.
+ * @param	state			embedDB algorithm state structure
+ * @param	readFn			Function that reads a page of the file into the read buffer of the file
+ * @param	file			File to search
+ * @param	buffer			Read buffer of the file
+ * @param	physicalPageId	Physical page the run starts at
+ * @param	logicalPageId	Logical page id of the page the run starts at
+ * @param	numPages		Number of pages in the file
+ * @return	Physical page id of the last page in the run
+ */
+id_t findLastConsecutivePage(embedDBState *state, int8_t (*readFn)(embedDBState *, id_t), void *file, void *buffer, id_t physicalPageId, id_t logicalPageId, id_t numPages) {
+    embedDBPageSearch search;
+    initPageSearch(&search, readFn, file, buffer, physicalPageId, logicalPageId, numPages);
+    findLastConsecutivePages(state, &search, 1);
+    return search.low;
+}
+
 int8_t embedDBInitDataFromFile(embedDBState *state) {
     id_t logicalPageId = 0;
     id_t maxLogicalPageId = 0;
@@ -354,19 +934,12 @@ int8_t embedDBInitDataFromFile(embedDBState *state) {
     if (!hasData)
         return 0;
 
-    while (moreToRead && count < state->numDataPages) {
-        memcpy(&logicalPageId, buffer, sizeof(id_t));
-        validData = logicalPageId % state->numDataPages == count;
-        if (validData && logicalPageId == maxLogicalPageId + 1) {
-            maxLogicalPageId = logicalPageId;
-            physicalPageId++;
-            updateMaxiumError(state, buffer);
-            moreToRead = !(readPage(state, physicalPageId));
-            count++;
-        } else {
-            break;
-        }
-    }
+    /* Pages are written in order, so the last page written is found with a binary search */
+    id_t lastPhysicalPageId = findLastConsecutivePage(state, readPage, state->dataFile, buffer, physicalPageId - 1, maxLogicalPageId, state->numDataPages);
+    maxLogicalPageId += lastPhysicalPageId + 1 - physicalPageId;
+    physicalPageId = lastPhysicalPageId + 1;
+    count = physicalPageId;
+    moreToRead = count < state->numDataPages && !(readPage(state, physicalPageId));
 
     /*
      * Now we need to find where the page with the smallest key that is still valid.
@@ -405,11 +978,6 @@ int8_t embedDBInitDataFromFile(embedDBState *state) {
 
     /* Put largest key back into the buffer */
     readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
-
-    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
-        embedDBInitSplineFromFile(state);
-    }
-
     return 0;
 }
 
@@ -452,19 +1020,11 @@ int8_t embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state) {
     }
 
     if (hasPermanentData) {
-        while (moreToRead && count < state->numDataPages) {
-            memcpy(&logicalPageId, buffer, sizeof(id_t));
-            validData = logicalPageId % state->numDataPages == count;
-            if (validData && logicalPageId == maxLogicalPageId + 1) {
-                maxLogicalPageId = logicalPageId;
-                physicalPageId++;
-                updateMaxiumError(state, buffer);
-                moreToRead = !(readPage(state, physicalPageId));
-                count++;
-            } else {
-                break;
-            }
-        }
+        /* Pages are written in order, so the last page written is found with a binary search */
+        id_t lastPhysicalPageId = findLastConsecutivePage(state, readPage, state->dataFile, buffer, physicalPageId - 1, maxLogicalPageId, state->numDataPages);
+        maxLogicalPageId += lastPhysicalPageId + 1 - physicalPageId;
+        physicalPageId = lastPhysicalPageId + 1;
+        count = physicalPageId;
     } else {
         /* Case where the there is no permanent pages written, but we may still have record-level consistency records in block 2 */
         count = 0;
@@ -577,18 +1137,23 @@ int8_t embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state) {
 
     /* Put largest key back into the buffer */
     readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
-    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
-        embedDBInitSplineFromFile(state);
-    }
-
     return 0;
 }
 
 void embedDBInitSplineFromFile(embedDBState *state) {
     id_t pageNumberToRead = state->minDataPageId;
     void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+
+    /* Start from the checkpoint if there is a valid one, so only pages written after it are read */
+    id_t checkpointPageId = 0;
+    if (EMBEDDB_PERSISTING_SPLINE(state->parameters) && readSplineCheckpoint(state, &checkpointPageId) == 0) {
+        pageNumberToRead = checkpointPageId;
+        if (!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters))
+            cleanSpline(state, state->minDataPageId);
+    }
+
     id_t pagesRead = 0;
-    id_t numberOfPagesToRead = state->nextDataPageId - state->minDataPageId;
+    id_t numberOfPagesToRead = state->nextDataPageId - pageNumberToRead;
     while (pagesRead < numberOfPagesToRead) {
         readPage(state, pageNumberToRead % state->numDataPages);
         splineAdd(state->spl, embedDBGetMinKey(state, buffer), pageNumberToRead++);
@@ -596,40 +1161,833 @@ void embedDBInitSplineFromFile(embedDBState *state) {
     }
 }
 
-int8_t embedDBInitIndex(embedDBState *state) {
-    /* Setup index file. */
-
-    /* 4 for id, 2 for count, 2 unused, 4 for minKey (pageId), 4 for maxKey (pageId) */
-    state->maxIdxRecordsPerPage = (state->pageSize - 16) / state->bitmapSize;
-
-    /* Allocate third page of buffer as index output page */
-    initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
-
-    /* Add page id to minimum value spot in page */
-    void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
-    id_t *ptr = ((id_t *)((int8_t *)buf + 8));
-    *ptr = state->nextDataPageId;
-
-    state->nextIdxPageId = 0;
-    state->numAvailIndexPages = state->numIndexPages;
-    state->minIndexPageId = 0;
+/**
+ * @brief	Records the smallest key of every data page still in the data file in the fence pointers.
+ * @param	state	embedDB algorithm state structure
+ */
+void embedDBInitFencePointersFromFile(embedDBState *state) {
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    for (id_t pageId = state->minDataPageId; pageId < state->nextDataPageId; pageId++) {
+        id_t physicalPageId = pageId % state->numDataPages;
+        if (readPage(state, physicalPageId) == 0)
+            memcpy((int8_t *)state->fencePointers + (size_t)physicalPageId * state->keySize, embedDBGetMinKey(state, buffer), state->keySize);
+    }
+}
 
-    if (state->numIndexPages < state->eraseSizeInPages * 2) {
+/**
+ * @brief	Opens the file the spline is checkpointed to.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitSplineFile(embedDBState *state) {
+    if (!EMBEDDB_USING_SPLINE(state->parameters)) {
 #ifdef PRINT_ERRORS
-        printf("ERROR: Minimum index space is two erase blocks\n");
+        printf("ERROR: EMBEDDB_PERSIST_SPLINE requires the spline index and cannot be used with EMBEDDB_USE_BINARY_SEARCH or EMBEDDB_USE_FENCE_POINTERS.\n");
 #endif
         return -1;
     }
 
-    if (state->numIndexPages % state->eraseSizeInPages != 0) {
+    if (state->splineFile == NULL) {
 #ifdef PRINT_ERRORS
-        printf("ERROR: Ensure index space is a multiple of erase block size\n");
+        printf("ERROR: No spline file provided!\n");
 #endif
         return -1;
     }
 
-    if (state->indexFile == NULL) {
-#ifdef PRINT_ERRORS
+    if (!EMBEDDB_RESETING_DATA(state->parameters) && state->fileInterface->open(state->splineFile, EMBEDDB_FILE_MODE_R_PLUS_B))
+        return 0;
+
+    if (!state->fileInterface->open(state->splineFile, EMBEDDB_FILE_MODE_W_PLUS_B)) {
+#ifdef PRINT_ERRORS
+        printf("Error: Can't open spline file!\n");
+#endif
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief	Adds bytes to a 32-bit FNV-1a hash.
+ */
+uint32_t checkpointHash(uint32_t hash, void *bytes, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        hash ^= ((uint8_t *)bytes)[i];
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+/**
+ * @brief	Writes the spline to the spline file so recovery only has to add the pages written after it.
+ * 			Page 0 holds the header and the pages after it hold the array of points as it is in memory.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success or the spline is not persisted, -1 if error.
+ */
+int8_t writeSplineCheckpoint(embedDBState *state) {
+    if (!EMBEDDB_PERSISTING_SPLINE(state->parameters))
+        return 0;
+
+    spline *spl = state->spl;
+    uint32_t pointSize = state->keySize + sizeof(uint32_t);
+    uint32_t pointBytes = spl->size * pointSize;
+    uint32_t numPointPages = (pointBytes + state->pageSize - 1) / state->pageSize;
+    uint32_t numPages = (1 + numPointPages + state->eraseSizeInPages - 1) / state->eraseSizeInPages * state->eraseSizeInPages;
+    int8_t *page = (int8_t *)malloc(state->pageSize);
+    if (page == NULL || !state->fileInterface->erase(0, numPages, state->pageSize, state->splineFile)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to checkpoint the spline.\n");
+#endif
+        free(page);
+        return -1;
+    }
+
+    /* Header */
+    uint32_t fields[SPLINE_CHECKPOINT_NUM_FIELDS] = {state->nextDataPageId, spl->count, spl->size, spl->pointsStartIndex, spl->lastLoc,
+                                                     spl->eraseSize, spl->maxError, spl->numAddCalls, spl->tempLastPoint, spl->keySize};
+    memset(page, 0, state->pageSize);
+    int8_t *header = page + sizeof(uint32_t);
+    memcpy(header, fields, sizeof(fields));
+    header += sizeof(fields);
+    memcpy(header, spl->lastKey, state->keySize);
+    header += state->keySize;
+    memcpy(header, spl->lower, pointSize);
+    header += pointSize;
+    memcpy(header, spl->upper, pointSize);
+    header += pointSize;
+    memcpy(header, spl->firstSplinePoint, pointSize);
+    header += pointSize;
+    uint32_t hash = checkpointHash(CHECKPOINT_HASH_BASIS, page + sizeof(uint32_t), header - page - sizeof(uint32_t));
+    hash = checkpointHash(hash, spl->points, pointBytes);
+    memcpy(page, &hash, sizeof(uint32_t));
+
+    /* The header is written last, so the checksum shows a checkpoint that was cut short */
+    int8_t success = 1;
+    for (uint32_t i = numPointPages; i > 0 && success; i--) {
+        uint32_t offset = (i - 1) * state->pageSize;
+        if (pointBytes - offset >= state->pageSize) {
+            success = state->fileInterface->write((int8_t *)spl->points + offset, i, state->pageSize, state->splineFile);
+        } else {
+            int8_t *lastPage = (int8_t *)malloc(state->pageSize);
+            success = lastPage != NULL;
+            if (success) {
+                memset(lastPage, 0, state->pageSize);
+                memcpy(lastPage, (int8_t *)spl->points + offset, pointBytes - offset);
+                success = state->fileInterface->write(lastPage, i, state->pageSize, state->splineFile);
+            }
+            free(lastPage);
+        }
+    }
+    success = success && state->fileInterface->write(page, 0, state->pageSize, state->splineFile) && state->fileInterface->flush(state->splineFile);
+    free(page);
+    if (!success) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to write the spline checkpoint.\n");
+#endif
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief	Loads the spline from the spline file. The checkpoint is only used if its checksum matches, it has the same
+ * 			spline configuration and the last page it covers is still in the data file with the key it recorded.
+ * @param	state				embedDB algorithm state structure
+ * @param	checkpointPageId	Set to the first data page that is not in the checkpoint
+ * @return	Return 0 if the checkpoint was loaded, -1 if the spline must be rebuilt from the data file.
+ */
+int8_t readSplineCheckpoint(embedDBState *state, id_t *checkpointPageId) {
+    spline *spl = state->spl;
+    uint32_t pointSize = state->keySize + sizeof(uint32_t);
+    uint32_t pointBytes = spl->size * pointSize;
+    uint32_t numPointPages = (pointBytes + state->pageSize - 1) / state->pageSize;
+    int8_t *page = (int8_t *)malloc(state->pageSize);
+    if (page == NULL || !state->fileInterface->read(page, 0, state->pageSize, state->splineFile)) {
+        free(page);
+        return -1;
+    }
+
+    uint32_t checksum, fields[SPLINE_CHECKPOINT_NUM_FIELDS];
+    memcpy(&checksum, page, sizeof(uint32_t));
+    memcpy(fields, page + sizeof(uint32_t), sizeof(fields));
+    id_t nextPageId = fields[0];
+    if (nextPageId == 0 || nextPageId > state->nextDataPageId || nextPageId - 1 < state->minDataPageId || fields[1] == 0 || fields[1] > spl->size ||
+        fields[2] != spl->size || fields[3] >= spl->size || fields[6] != spl->maxError || fields[9] != state->keySize) {
+        free(page);
+        return -1;
+    }
+
+    /* The spline is still empty, so its limits and points can be overwritten before the checkpoint is known to be valid */
+    int8_t *header = page + sizeof(uint32_t) + sizeof(fields);
+    memcpy(spl->lastKey, header, state->keySize);
+    header += state->keySize;
+    memcpy(spl->lower, header, pointSize);
+    header += pointSize;
+    memcpy(spl->upper, header, pointSize);
+    header += pointSize;
+    memcpy(spl->firstSplinePoint, header, pointSize);
+    header += pointSize;
+    uint32_t hash = checkpointHash(CHECKPOINT_HASH_BASIS, page + sizeof(uint32_t), header - page - sizeof(uint32_t));
+
+    int8_t success = 1;
+    for (uint32_t i = 0; i < numPointPages && success; i++) {
+        uint32_t offset = i * state->pageSize;
+        if (pointBytes - offset >= state->pageSize) {
+            success = state->fileInterface->read((int8_t *)spl->points + offset, i + 1, state->pageSize, state->splineFile);
+        } else {
+            success = state->fileInterface->read(page, i + 1, state->pageSize, state->splineFile);
+            memcpy((int8_t *)spl->points + offset, page, pointBytes - offset);
+        }
+    }
+    free(page);
+    hash = checkpointHash(hash, spl->points, pointBytes);
+    if (!success || hash != checksum)
+        return -1;
+
+    /* Check the data file has not been replaced since the checkpoint */
+    if (readPage(state, (nextPageId - 1) % state->numDataPages) != 0)
+        return -1;
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    if (memcmp(embedDBGetMinKey(state, buffer), spl->lastKey, state->keySize) != 0)
+        return -1;
+
+    spl->count = fields[1];
+    spl->pointsStartIndex = fields[3];
+    spl->lastLoc = fields[4];
+    spl->eraseSize = fields[5];
+    spl->numAddCalls = fields[7];
+    spl->tempLastPoint = fields[8];
+    splineRadixRebuild(spl);
+    *checkpointPageId = nextPageId;
+    return 0;
+}
+
+/**
+ * @brief	Opens the file the superblock is written to.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitSuperblockFile(embedDBState *state) {
+    if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: EMBEDDB_USE_SUPERBLOCK cannot be used with EMBEDDB_RECORD_LEVEL_CONSISTENCY.\n");
+#endif
+        return -1;
+    }
+
+    if (state->superblockFile == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: No superblock file provided!\n");
+#endif
+        return -1;
+    }
+
+    state->superblockSequence = 0;
+    if (!EMBEDDB_RESETING_DATA(state->parameters) && state->fileInterface->open(state->superblockFile, EMBEDDB_FILE_MODE_R_PLUS_B))
+        return 0;
+
+    if (!state->fileInterface->open(state->superblockFile, EMBEDDB_FILE_MODE_W_PLUS_B)) {
+#ifdef PRINT_ERRORS
+        printf("Error: Can't open superblock file!\n");
+#endif
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief	Writes the superblock to the older of its two slots, after flushing the files it describes.
+ * 			Each slot is in its own erase block, so the last superblock written survives if this one is cut short.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success or the superblock is not used, -1 if error.
+ */
+int8_t writeSuperblock(embedDBState *state) {
+    if (!EMBEDDB_USING_SUPERBLOCK(state->parameters))
+        return 0;
+
+    /* The superblock must not point past pages that are not stored yet */
+    state->fileInterface->flush(state->dataFile);
+    if (state->indexFile != NULL)
+        state->fileInterface->flush(state->indexFile);
+    if (state->varFile != NULL)
+        state->fileInterface->flush(state->varFile);
+
+    embedDBSuperblock superblock = {state->superblockSequence + 1, state->pageSize, state->numDataPages, state->numIndexPages,
+                                    state->numVarPages, state->eraseSizeInPages, state->nextDataPageId, state->minDataPageId,
+                                    state->nextIdxPageId, state->minIndexPageId, state->nextVarPageId, state->numAvailVarPages,
+                                    state->minVarRecordId, 0};
+    superblock.checksum = checkpointHash(CHECKPOINT_HASH_BASIS, &superblock, offsetof(embedDBSuperblock, checksum));
+
+    int8_t *page = (int8_t *)malloc(state->pageSize);
+    if (page == NULL)
+        return -1;
+    memset(page, 0, state->pageSize);
+    memcpy(page, &superblock, sizeof(embedDBSuperblock));
+
+    id_t slotPageId = superblock.sequence % 2 * state->eraseSizeInPages;
+    int8_t success = state->fileInterface->erase(slotPageId, slotPageId + state->eraseSizeInPages, state->pageSize, state->superblockFile) &&
+                     state->fileInterface->write(page, slotPageId, state->pageSize, state->superblockFile) &&
+                     state->fileInterface->flush(state->superblockFile);
+    free(page);
+    if (!success) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to write the superblock.\n");
+#endif
+        return -1;
+    }
+    state->superblockSequence = superblock.sequence;
+    return 0;
+}
+
+/**
+ * @brief	Reads the newest valid superblock. A slot is valid if its checksum matches and it was written with the same file sizes.
+ * @param	state		embedDB algorithm state structure
+ * @param	superblock	Set to the newest valid superblock
+ * @return	Return 0 if a superblock was found, -1 if recovery has to scan the files.
+ */
+int8_t readSuperblock(embedDBState *state, embedDBSuperblock *superblock) {
+    int8_t *page = (int8_t *)malloc(state->pageSize);
+    if (page == NULL)
+        return -1;
+
+    int8_t found = 0;
+    for (id_t slot = 0; slot < 2; slot++) {
+        embedDBSuperblock candidate;
+        if (!state->fileInterface->read(page, slot * state->eraseSizeInPages, state->pageSize, state->superblockFile))
+            continue;
+        memcpy(&candidate, page, sizeof(embedDBSuperblock));
+        if (candidate.checksum != checkpointHash(CHECKPOINT_HASH_BASIS, &candidate, offsetof(embedDBSuperblock, checksum)))
+            continue;
+        if (candidate.pageSize != state->pageSize || candidate.numDataPages != state->numDataPages || candidate.numIndexPages != state->numIndexPages ||
+            candidate.numVarPages != state->numVarPages || candidate.eraseSizeInPages != state->eraseSizeInPages)
+            continue;
+        if (!found || candidate.sequence > superblock->sequence) {
+            *superblock = candidate;
+            found = 1;
+        }
+    }
+    free(page);
+
+    if (!found)
+        return -1;
+    state->superblockSequence = superblock->sequence;
+    return 0;
+}
+
+/**
+ * @brief	Opens the file the learned bitmap buckets are saved to and loads them if they were learned before.
+ * 			Otherwise allocates the sample they are learned from.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitBitmapFile(embedDBState *state) {
+    if (!EMBEDDB_USING_BMAP(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: EMBEDDB_USE_LEARNED_BITMAP requires EMBEDDB_USE_BMAP.\n");
+#endif
+        return -1;
+    }
+
+    uint32_t numBoundaries = state->bitmapSize * 8 - 1;
+    if (BITMAP_BUCKETS_HEADER_SIZE + numBoundaries * state->dataSize > state->pageSize) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: The learned bitmap buckets do not fit in a page. Use a smaller bitmap or larger pages.\n");
+#endif
+        return -1;
+    }
+
+    if (state->bitmapFile == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: No bitmap file provided!\n");
+#endif
+        return -1;
+    }
+
+    state->bitmapBoundaries = malloc((size_t)numBoundaries * state->dataSize);
+    if (state->bitmapBoundaries == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to allocate the learned bitmap buckets.\n");
+#endif
+        return -1;
+    }
+    state->numBitmapSamples = 0;
+    state->bitmapLearned = 0;
+
+    if (!EMBEDDB_RESETING_DATA(state->parameters) && state->fileInterface->open(state->bitmapFile, EMBEDDB_FILE_MODE_R_PLUS_B)) {
+        if (readBitmapBuckets(state) == 0) {
+            state->bitmapLearned = 1;
+            return 0;
+        }
+    } else if (!state->fileInterface->open(state->bitmapFile, EMBEDDB_FILE_MODE_W_PLUS_B)) {
+#ifdef PRINT_ERRORS
+        printf("Error: Can't open bitmap file!\n");
+#endif
+        return -1;
+    }
+
+    /* Pages written without saved buckets were written before learning, so their bitmaps match every query */
+    if (state->bitmapSampleSize > 0) {
+        state->bitmapSample = malloc((size_t)state->bitmapSampleSize * state->dataSize);
+        if (state->bitmapSample == NULL) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: Unable to allocate the bitmap sample.\n");
+#endif
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief	Saves the learned bitmap buckets to the first page of the bitmap file.
+ * 			The page holds a checksum, the number of boundaries, the data size, then the boundaries.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t writeBitmapBuckets(embedDBState *state) {
+    int8_t *page = (int8_t *)malloc(state->pageSize);
+    if (page == NULL)
+        return -1;
+    memset(page, 0, state->pageSize);
+
+    uint32_t header[3] = {0, (uint32_t)state->bitmapSize * 8 - 1, (uint32_t)state->dataSize};
+    uint32_t boundariesSize = header[1] * state->dataSize;
+    memcpy(page + BITMAP_BUCKETS_HEADER_SIZE, state->bitmapBoundaries, boundariesSize);
+    memcpy(page, header, BITMAP_BUCKETS_HEADER_SIZE);
+    header[0] = checkpointHash(CHECKPOINT_HASH_BASIS, page + sizeof(uint32_t), BITMAP_BUCKETS_HEADER_SIZE - sizeof(uint32_t) + boundariesSize);
+    memcpy(page, header, sizeof(uint32_t));
+
+    int8_t success = state->fileInterface->erase(0, state->eraseSizeInPages, state->pageSize, state->bitmapFile) &&
+                     state->fileInterface->write(page, 0, state->pageSize, state->bitmapFile) &&
+                     state->fileInterface->flush(state->bitmapFile);
+    free(page);
+    if (!success) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to write the learned bitmap buckets.\n");
+#endif
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief	Reads the learned bitmap buckets saved by writeBitmapBuckets.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if valid buckets for this bitmap and data size were read, -1 otherwise.
+ */
+int8_t readBitmapBuckets(embedDBState *state) {
+    int8_t *page = (int8_t *)malloc(state->pageSize);
+    if (page == NULL)
+        return -1;
+
+    int8_t valid = 0;
+    uint32_t header[3];
+    if (state->fileInterface->read(page, 0, state->pageSize, state->bitmapFile)) {
+        memcpy(header, page, BITMAP_BUCKETS_HEADER_SIZE);
+        uint32_t boundariesSize = ((uint32_t)state->bitmapSize * 8 - 1) * state->dataSize;
+        valid = header[1] == (uint32_t)state->bitmapSize * 8 - 1 && header[2] == (uint32_t)state->dataSize &&
+                header[0] == checkpointHash(CHECKPOINT_HASH_BASIS, page + sizeof(uint32_t), BITMAP_BUCKETS_HEADER_SIZE - sizeof(uint32_t) + boundariesSize);
+        if (valid)
+            memcpy(state->bitmapBoundaries, page + BITMAP_BUCKETS_HEADER_SIZE, boundariesSize);
+    }
+    free(page);
+    return valid ? 0 : -1;
+}
+
+/**
+ * @brief	Sorts data values with a shell sort, which needs no extra memory.
+ */
+static void sortDataValues(embedDBState *state, int8_t *values, uint32_t numValues, void *temp) {
+    for (uint32_t gap = numValues / 2; gap > 0; gap = gap == 2 ? 1 : gap * 5 / 11) {
+        for (uint32_t i = gap; i < numValues; i++) {
+            memcpy(temp, values + (size_t)i * state->dataSize, state->dataSize);
+            uint32_t j = i;
+            while (j >= gap && embedDBCompareData(state, values + (size_t)(j - gap) * state->dataSize, temp) > 0) {
+                memcpy(values + (size_t)j * state->dataSize, values + (size_t)(j - gap) * state->dataSize, state->dataSize);
+                j -= gap;
+            }
+            memcpy(values + (size_t)j * state->dataSize, temp, state->dataSize);
+        }
+    }
+}
+
+/**
+ * @brief	Learns equi-depth bitmap buckets from a sample, so each bucket holds about the same number of sampled values.
+ * 			Saves the buckets and rebuilds the bitmap of the page being written with them.
+ * @param	state		embedDB algorithm state structure
+ * @param	sample		Data values to learn from. Sorted in place
+ * @param	numValues	Number of values in the sample
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t learnBitmapBuckets(embedDBState *state, void *sample, uint32_t numValues) {
+    void *temp = malloc(state->dataSize);
+    if (temp == NULL)
+        return -1;
+    sortDataValues(state, (int8_t *)sample, numValues, temp);
+    free(temp);
+
+    uint32_t numBuckets = state->bitmapSize * 8;
+    for (uint32_t i = 1; i < numBuckets; i++)
+        memcpy((int8_t *)state->bitmapBoundaries + (size_t)(i - 1) * state->dataSize, (int8_t *)sample + (size_t)((uint64_t)i * numValues / numBuckets) * state->dataSize, state->dataSize);
+
+    if (writeBitmapBuckets(state) != 0)
+        return -1;
+
+    state->bitmapLearned = 1;
+    free(state->bitmapSample);
+    state->bitmapSample = NULL;
+
+    /* Records already in the write buffer were given every bit before learning */
+    void *bm = EMBEDDB_GET_BITMAP(state->buffer);
+    memset(bm, 0, state->bitmapSize);
+    count_t count = EMBEDDB_GET_COUNT(state->buffer);
+    for (count_t i = 0; i < count; i++)
+        embedDBUpdateBitmap(state, (int8_t *)state->buffer + state->headerSize + (size_t)i * state->recordSize + state->keySize, bm);
+    return 0;
+}
+
+int8_t embedDBLearnBitmap(embedDBState *state, void *sample, uint32_t numValues) {
+    if (!EMBEDDB_USING_LEARNED_BITMAP(state->parameters) || state->bitmapLearned || numValues == 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: The bitmap buckets can only be learned once from a non-empty sample with EMBEDDB_USE_LEARNED_BITMAP.\n");
+#endif
+        return -1;
+    }
+
+    void *values = malloc((size_t)numValues * state->dataSize);
+    if (values == NULL)
+        return -1;
+    memcpy(values, sample, (size_t)numValues * state->dataSize);
+    int8_t result = learnBitmapBuckets(state, values, numValues);
+    free(values);
+    return result;
+}
+
+/**
+ * @brief	Opens the file the index page summaries are checkpointed to and allocates the summaries.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitSummaryFile(embedDBState *state) {
+    if (!EMBEDDB_USING_INDEX(state->parameters) || !EMBEDDB_USING_BMAP(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: EMBEDDB_USE_INDEX_SUMMARY summarizes the bitmaps in the index and requires EMBEDDB_USE_INDEX and EMBEDDB_USE_BMAP.\n");
+#endif
+        return -1;
+    }
+
+    if (state->summaryFile == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: No summary file provided!\n");
+#endif
+        return -1;
+    }
+
+    state->indexSummaries = calloc(state->numIndexPages, INDEX_SUMMARY_SIZE(state));
+    if (state->indexSummaries == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to allocate the index page summaries.\n");
+#endif
+        return -1;
+    }
+
+    if (!EMBEDDB_RESETING_DATA(state->parameters) && state->fileInterface->open(state->summaryFile, EMBEDDB_FILE_MODE_R_PLUS_B))
+        return 0;
+
+    if (!state->fileInterface->open(state->summaryFile, EMBEDDB_FILE_MODE_W_PLUS_B)) {
+#ifdef PRINT_ERRORS
+        printf("Error: Can't open summary file!\n");
+#endif
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief	Checkpoints the index page summaries to the summary file. Index pages written after the checkpoint are summarized again on restart.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success or the summaries are not used, -1 if error.
+ */
+int8_t writeIndexSummaries(embedDBState *state) {
+    if (state->summaryFile == NULL)
+        return 0;
+
+    uint32_t header[4] = {0, state->nextIdxPageId, state->numIndexPages, (uint32_t)state->bitmapSize};
+    uint32_t summariesSize = state->numIndexPages * INDEX_SUMMARY_SIZE(state);
+    header[0] = checkpointHash(CHECKPOINT_HASH_BASIS, header + 1, INDEX_SUMMARY_HEADER_SIZE - sizeof(uint32_t));
+    header[0] = checkpointHash(header[0], state->indexSummaries, summariesSize);
+
+    int8_t *page = (int8_t *)malloc(state->pageSize);
+    if (page == NULL)
+        return -1;
+
+    uint32_t totalSize = INDEX_SUMMARY_HEADER_SIZE + summariesSize;
+    id_t numPages = (totalSize + state->pageSize - 1) / state->pageSize;
+    id_t numErasePages = (numPages + state->eraseSizeInPages - 1) / state->eraseSizeInPages * state->eraseSizeInPages;
+    int8_t success = state->fileInterface->erase(0, numErasePages, state->pageSize, state->summaryFile);
+    for (id_t pageNum = 0; success && pageNum < numPages; pageNum++) {
+        /* The header and summaries are written as one stream split across pages */
+        memset(page, 0, state->pageSize);
+        for (uint32_t i = 0; i < state->pageSize && pageNum * state->pageSize + i < totalSize; i++) {
+            uint32_t offset = pageNum * state->pageSize + i;
+            page[i] = offset < INDEX_SUMMARY_HEADER_SIZE ? ((int8_t *)header)[offset] : ((int8_t *)state->indexSummaries)[offset - INDEX_SUMMARY_HEADER_SIZE];
+        }
+        success = state->fileInterface->write(page, pageNum, state->pageSize, state->summaryFile);
+    }
+    success = success && state->fileInterface->flush(state->summaryFile);
+    free(page);
+    if (!success) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to write the index page summaries.\n");
+#endif
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief	Loads the index page summaries from their checkpoint, then summarizes the index pages written after it by reading them.
+ * 			Every index page is read if there is no valid checkpoint.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success, -1 if an index page could not be read.
+ */
+int8_t embedDBInitIndexSummaries(embedDBState *state) {
+    id_t summarizedPageId = state->minIndexPageId;
+    if (!EMBEDDB_RESETING_DATA(state->parameters)) {
+        int8_t *page = (int8_t *)malloc(state->pageSize);
+        if (page == NULL)
+            return -1;
+
+        uint32_t header[4];
+        uint32_t summariesSize = state->numIndexPages * INDEX_SUMMARY_SIZE(state);
+        uint32_t totalSize = INDEX_SUMMARY_HEADER_SIZE + summariesSize;
+        id_t numPages = (totalSize + state->pageSize - 1) / state->pageSize;
+        int8_t valid = 1;
+        for (id_t pageNum = 0; valid && pageNum < numPages; pageNum++) {
+            valid = state->fileInterface->read(page, pageNum, state->pageSize, state->summaryFile);
+            for (uint32_t i = 0; valid && i < state->pageSize && pageNum * state->pageSize + i < totalSize; i++) {
+                uint32_t offset = pageNum * state->pageSize + i;
+                if (offset < INDEX_SUMMARY_HEADER_SIZE)
+                    ((int8_t *)header)[offset] = page[i];
+                else
+                    ((int8_t *)state->indexSummaries)[offset - INDEX_SUMMARY_HEADER_SIZE] = page[i];
+            }
+        }
+        free(page);
+
+        valid = valid && header[2] == state->numIndexPages && header[3] == (uint32_t)state->bitmapSize && header[1] <= state->nextIdxPageId &&
+                header[0] == checkpointHash(checkpointHash(CHECKPOINT_HASH_BASIS, header + 1, INDEX_SUMMARY_HEADER_SIZE - sizeof(uint32_t)), state->indexSummaries, summariesSize);
+        if (valid)
+            summarizedPageId = max(header[1], state->minIndexPageId);
+    }
+
+    for (id_t indexPageId = summarizedPageId; indexPageId < state->nextIdxPageId; indexPageId++) {
+        id_t physicalPageNumber = indexPageId % state->numIndexPages;
+        if (readIndexPage(state, physicalPageNumber) != 0)
+            return -1;
+        updateIndexSummary(state, (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER, physicalPageNumber);
+    }
+    return 0;
+}
+
+/**
+ * @brief	Checks that the page a logical page id is stored at holds that page.
+ * @return	1 if the page was read and has the logical page id, 0 otherwise
+ */
+static inline int8_t pageHasLogicalId(embedDBState *state, int8_t (*readFn)(embedDBState *, id_t), void *buffer, id_t logicalPageId, uint32_t numPages) {
+    id_t pageId;
+    if (readFn(state, logicalPageId % numPages) != 0)
+        return 0;
+    memcpy(&pageId, buffer, sizeof(id_t));
+    return pageId == logicalPageId;
+}
+
+/**
+ * @brief	Finds the first and next page ids of a file from the ones in the superblock. Only the pages written after the
+ * 			superblock are read, and the oldest page is moved forward past blocks that have been erased since.
+ * @param	state		embedDB algorithm state structure
+ * @param	readFn		Function that reads a page of the file into the read buffer of the file
+ * @param	buffer		Read buffer of the file
+ * @param	numPages	Number of pages in the file
+ * @param	minPageId	Oldest logical page id in the superblock. Set to the oldest page id still in the file
+ * @param	nextPageId	Next logical page id in the superblock. Set to the id after the last page in the file
+ * @return	Return 0 if success, -1 if the file does not match the superblock.
+ */
+int8_t recoverFromSuperblock(embedDBState *state, int8_t (*readFn)(embedDBState *, id_t), void *buffer, uint32_t numPages, id_t *minPageId, id_t *nextPageId) {
+    id_t minId = *minPageId, nextId = *nextPageId;
+    if (minId > nextId || nextId - minId > numPages)
+        return -1;
+
+    /* The last page the superblock knows of must still be there */
+    if (nextId > minId && !pageHasLogicalId(state, readFn, buffer, nextId - 1, numPages))
+        return -1;
+
+    /* Add the pages written after the superblock. Each page written to a full file erased the oldest block first */
+    for (uint32_t i = 0; i < numPages && pageHasLogicalId(state, readFn, buffer, nextId, numPages); i++) {
+        if (nextId - minId == numPages)
+            minId += state->eraseSizeInPages;
+        nextId++;
+    }
+
+    /* embedDBMaintenance may have erased the oldest block before it was needed */
+    while (minId < nextId && !pageHasLogicalId(state, readFn, buffer, minId, numPages))
+        minId += state->eraseSizeInPages;
+    if (minId > nextId || (minId == nextId && nextId > *minPageId))
+        return -1;
+
+    *minPageId = minId;
+    *nextPageId = nextId;
+    return 0;
+}
+
+/**
+ * @brief	Recovers the data file from the superblock instead of scanning it.
+ * @param	state		embedDB algorithm state structure
+ * @param	superblock	Superblock read from the superblock file
+ * @return	Return 0 if success, -1 if the data file must be scanned.
+ */
+int8_t embedDBInitDataFromSuperblock(embedDBState *state, embedDBSuperblock *superblock) {
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    id_t minDataPageId = superblock->minDataPageId, nextDataPageId = superblock->nextDataPageId;
+    if (recoverFromSuperblock(state, readPage, buffer, state->numDataPages, &minDataPageId, &nextDataPageId) != 0)
+        return -1;
+
+    state->nextDataPageId = nextDataPageId;
+    state->minDataPageId = minDataPageId;
+    state->numAvailDataPages = state->numDataPages + minDataPageId - nextDataPageId;
+    if (nextDataPageId == 0)
+        return 0;
+
+    /* Put largest key back into the buffer */
+    readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
+    return 0;
+}
+
+/**
+ * @brief	Recovers the index file from the superblock instead of scanning it.
+ * @param	state		embedDB algorithm state structure
+ * @param	superblock	Superblock read from the superblock file
+ * @return	Return 0 if success, -1 if the index file must be scanned.
+ */
+int8_t embedDBInitIndexFromSuperblock(embedDBState *state, embedDBSuperblock *superblock) {
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
+    id_t minIndexPageId = superblock->minIndexPageId, nextIdxPageId = superblock->nextIdxPageId;
+    if (recoverFromSuperblock(state, readIndexPage, buffer, state->numIndexPages, &minIndexPageId, &nextIdxPageId) != 0)
+        return -1;
+
+    state->nextIdxPageId = nextIdxPageId;
+    state->minIndexPageId = minIndexPageId;
+    state->numAvailIndexPages = state->numIndexPages + minIndexPageId - nextIdxPageId;
+    return embedDBPinIndexPages(state);
+}
+
+/**
+ * @brief	Recovers the variable data file from the superblock instead of scanning it.
+ * @param	state		embedDB algorithm state structure
+ * @param	superblock	Superblock read from the superblock file
+ * @return	Return 0 if success, -1 if the variable data file must be scanned.
+ */
+int8_t embedDBInitVarDataFromSuperblock(embedDBState *state, embedDBSuperblock *superblock) {
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
+    id_t nextVarPageId = superblock->nextVarPageId;
+    id_t minVarPageId = nextVarPageId + superblock->numAvailVarPages - state->numVarPages;
+    if (recoverFromSuperblock(state, readVariablePage, buffer, state->numVarPages, &minVarPageId, &nextVarPageId) != 0)
+        return -1;
+
+    uint64_t minVarRecordId = superblock->minVarRecordId;
+    if (minVarPageId != superblock->nextVarPageId + superblock->numAvailVarPages - state->numVarPages) {
+        /* Blocks were erased after the superblock. We lose some records, but know for sure we have all records larger than this */
+        if (readVariablePage(state, minVarPageId % state->numVarPages) != 0)
+            return -1;
+        minVarRecordId = 0;
+        memcpy(&minVarRecordId, (int8_t *)buffer + sizeof(id_t), state->keySize);
+        minVarRecordId++;
+    } else if (minVarRecordId == UINT64_MAX && nextVarPageId > superblock->nextVarPageId) {
+        /* The first variable data was written after the superblock */
+        return -1;
+    }
+
+    state->nextVarPageId = nextVarPageId;
+    state->minVarRecordId = minVarRecordId;
+    state->numAvailVarPages = state->numVarPages + minVarPageId - nextVarPageId;
+    state->currentVarLoc = state->nextVarPageId % state->numVarPages * state->pageSize + state->variableDataHeaderSize;
+    return 0;
+}
+
+/**
+ * @brief	Writes the spline checkpoint and the superblock if they are enabled.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t writeCheckpoints(embedDBState *state) {
+    if (writeSplineCheckpoint(state) != 0)
+        return -1;
+    if (writeIndexSummaries(state) != 0)
+        return -1;
+    return writeSuperblock(state);
+}
+
+int8_t embedDBInitIndex(embedDBState *state, embedDBPageSearch *search) {
+    /* Setup index file. */
+
+    /* Each data page has its bitmap in the index, followed by its Bloom filter if they are used */
+    state->bloomFilterSize = 0;
+    if (EMBEDDB_USING_BLOOM_FILTER(state->parameters)) {
+        if (state->bloomBitsPerKey == 0) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: EMBEDDB_USE_BLOOM_FILTER requires bloomBitsPerKey to be at least 1.\n");
+#endif
+            return -1;
+        }
+        state->bloomFilterSize = ((uint32_t)state->maxRecordsPerPage * state->bloomBitsPerKey + 7) / 8;
+    }
+    state->indexRecordSize = state->bitmapSize + state->bloomFilterSize;
+    if (EMBEDDB_USING_ZONE_MAP(state->parameters)) {
+        if (!EMBEDDB_USING_MAX_MIN(state->parameters)) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: EMBEDDB_USE_ZONE_MAP copies the min and max data of each page into the index and requires EMBEDDB_USE_MAX_MIN.\n");
+#endif
+            return -1;
+        }
+        state->indexRecordSize += state->dataSize * 2;
+    }
+    if (state->indexRecordSize > state->pageSize - EMBEDDB_IDX_HEADER_SIZE) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: The index record of a data page does not fit on an index page.\n");
+#endif
+        return -1;
+    }
+
+    /* 4 for id, 2 for count, 2 unused, 4 for minKey (pageId), 4 for maxKey (pageId) */
+    state->maxIdxRecordsPerPage = (state->pageSize - 16) / state->indexRecordSize;
+
+    /* Allocate third page of buffer as index output page */
+    initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
+
+    /* Add page id to minimum value spot in page */
+    void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
+    id_t *ptr = ((id_t *)((int8_t *)buf + 8));
+    *ptr = state->nextDataPageId;
+
+    state->nextIdxPageId = 0;
+    state->numAvailIndexPages = state->numIndexPages;
+    state->minIndexPageId = 0;
+
+    if (state->numIndexPages < state->eraseSizeInPages * 2) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Minimum index space is two erase blocks\n");
+#endif
+        return -1;
+    }
+
+    if (state->numIndexPages % state->eraseSizeInPages != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Ensure index space is a multiple of erase block size\n");
+#endif
+        return -1;
+    }
+
+    if (state->indexFile == NULL) {
+#ifdef PRINT_ERRORS
         printf("ERROR: No index file provided!\n");
 #endif
         return -1;
@@ -638,7 +1996,11 @@ int8_t embedDBInitIndex(embedDBState *state) {
     if (!EMBEDDB_RESETING_DATA(state->parameters)) {
         int8_t openStatus = state->fileInterface->open(state->indexFile, EMBEDDB_FILE_MODE_R_PLUS_B);
         if (openStatus) {
-            return embedDBInitIndexFromFile(state);
+            embedDBSuperblock superblock;
+            if (EMBEDDB_USING_SUPERBLOCK(state->parameters) && readSuperblock(state, &superblock) == 0 && embedDBInitIndexFromSuperblock(state, &superblock) == 0) {
+                return 0;
+            }
+            return embedDBInitIndexFromFile(state, search);
         }
     }
 
@@ -653,34 +2015,43 @@ int8_t embedDBInitIndex(embedDBState *state) {
     return 0;
 }
 
-int8_t embedDBInitIndexFromFile(embedDBState *state) {
-    id_t logicalIndexPageId = 0;
-    id_t maxLogicaIndexPageId = 0;
-    id_t physicalIndexPageId = 0;
+/**
+ * @brief	Starts recovering the index file by a scan. The scan is finished by embedDBFinishIndexFromFile once the last page written is found.
+ * @param	state	embedDB algorithm state structure
+ * @param	search	Search for the last page written. Left empty if the index file has no pages
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t embedDBInitIndexFromFile(embedDBState *state, embedDBPageSearch *search) {
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
+    if (readIndexPage(state, 0) != 0)
+        return 0;
 
-    /* This will become zero if there is no more to read */
-    int8_t moreToRead = !(readIndexPage(state, physicalIndexPageId));
+    /* Pages are written in order, so the last page written is found with a binary search */
+    id_t logicalIndexPageId = 0;
+    memcpy(&logicalIndexPageId, buffer, sizeof(id_t));
+    initPageSearch(search, readIndexPage, state->indexFile, buffer, 0, logicalIndexPageId, state->numIndexPages);
+    return 0;
+}
 
+/**
+ * @brief	Finishes recovering the index file by a scan once the last page written is found.
+ * @param	state	embedDB algorithm state structure
+ * @param	search	Finished search for the last page written
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t embedDBFinishIndexFromFile(embedDBState *state, embedDBPageSearch *search) {
+    id_t logicalIndexPageId = search->logicalPageId;
+    id_t maxLogicaIndexPageId = logicalIndexPageId + search->low;
+    id_t physicalIndexPageId = search->low + 1;
     bool haveWrappedInMemory = false;
-    int count = 0;
-    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
+    void *buffer = search->buffer;
 
-    while (moreToRead && count < state->numIndexPages) {
+    /* The page after the last one written is from the previous pass over the file if the index has wrapped */
+    if (physicalIndexPageId < state->numIndexPages && readIndexPage(state, physicalIndexPageId) == 0) {
         memcpy(&logicalIndexPageId, buffer, sizeof(id_t));
-        if (count == 0 || logicalIndexPageId == maxLogicaIndexPageId + 1) {
-            maxLogicaIndexPageId = logicalIndexPageId;
-            physicalIndexPageId++;
-            moreToRead = !(readIndexPage(state, physicalIndexPageId));
-            count++;
-        } else {
-            haveWrappedInMemory = logicalIndexPageId == maxLogicaIndexPageId - state->numIndexPages + 1;
-            break;
-        }
+        haveWrappedInMemory = logicalIndexPageId == maxLogicaIndexPageId - state->numIndexPages + 1;
     }
 
-    if (count == 0)
-        return 0;
-
     state->nextIdxPageId = maxLogicaIndexPageId + 1;
     id_t physicalPageIDOfSmallestData = 0;
     if (haveWrappedInMemory) {
@@ -689,11 +2060,25 @@ int8_t embedDBInitIndexFromFile(embedDBState *state) {
     readIndexPage(state, physicalPageIDOfSmallestData);
     memcpy(&(state->minIndexPageId), buffer, sizeof(id_t));
     state->numAvailIndexPages = state->numIndexPages + state->minIndexPageId - maxLogicaIndexPageId - 1;
+    return embedDBPinIndexPages(state);
+}
 
+/**
+ * @brief	Loads the index pages recovery did not read so queries never read the index file. Does nothing unless the index is pinned.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t embedDBPinIndexPages(embedDBState *state) {
+    if (state->indexPool.pinned) {
+        for (id_t indexPageId = state->minIndexPageId; indexPageId < state->nextIdxPageId; indexPageId++) {
+            if (readIndexPage(state, indexPageId % state->numIndexPages) != 0)
+                return -1;
+        }
+    }
     return 0;
 }
 
-int8_t embedDBInitVarData(embedDBState *state) {
+int8_t embedDBInitVarData(embedDBState *state, embedDBPageSearch *search) {
     // Initialize variable data outpt buffer
     initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
 
@@ -706,7 +2091,11 @@ int8_t embedDBInitVarData(embedDBState *state) {
     if (!EMBEDDB_RESETING_DATA(state->parameters) && (state->nextDataPageId > 0 || EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters))) {
         int8_t openResult = state->fileInterface->open(state->varFile, EMBEDDB_FILE_MODE_R_PLUS_B);
         if (openResult) {
-            return embedDBInitVarDataFromFile(state);
+            embedDBSuperblock superblock;
+            if (EMBEDDB_USING_SUPERBLOCK(state->parameters) && readSuperblock(state, &superblock) == 0 && embedDBInitVarDataFromSuperblock(state, &superblock) == 0) {
+                return 0;
+            }
+            return embedDBInitVarDataFromFile(state, search);
         }
     }
 
@@ -721,7 +2110,13 @@ int8_t embedDBInitVarData(embedDBState *state) {
     return 0;
 }
 
-int8_t embedDBInitVarDataFromFile(embedDBState *state) {
+/**
+ * @brief	Starts recovering the variable data file by a scan. The scan is finished by embedDBFinishVarDataFromFile once the last page written is found.
+ * @param	state	embedDB algorithm state structure
+ * @param	search	Search for the last page written. Left empty if the variable data file has no data
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t embedDBInitVarDataFromFile(embedDBState *state, embedDBPageSearch *search) {
     id_t logicalVariablePageId = 0;
     id_t maxLogicalVariablePageId = 0;
     id_t physicalVariablePageId = 0;
@@ -767,18 +2162,26 @@ int8_t embedDBInitVarDataFromFile(embedDBState *state) {
     if (!hasData)
         return 0;
 
-    while (moreToRead && count < state->numVarPages) {
-        memcpy(&logicalVariablePageId, buffer, sizeof(id_t));
-        validData = logicalVariablePageId % state->numVarPages == count;
-        if (validData && logicalVariablePageId == maxLogicalVariablePageId + 1) {
-            maxLogicalVariablePageId = logicalVariablePageId;
-            physicalVariablePageId++;
-            moreToRead = !(readVariablePage(state, physicalVariablePageId));
-            count++;
-        } else {
-            break;
-        }
-    }
+    /* Pages are written in order, so the last page written is found with a binary search */
+    initPageSearch(search, readVariablePage, state->varFile, buffer, physicalVariablePageId - 1, maxLogicalVariablePageId, state->numVarPages);
+    return 0;
+}
+
+/**
+ * @brief	Finishes recovering the variable data file by a scan once the last page written is found.
+ * @param	state	embedDB algorithm state structure
+ * @param	search	Finished search for the last page written
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t embedDBFinishVarDataFromFile(embedDBState *state, embedDBPageSearch *search) {
+    id_t logicalVariablePageId = 0;
+    id_t maxLogicalVariablePageId = search->logicalPageId + (search->low - search->physicalPageId);
+    id_t physicalVariablePageId = search->low + 1;
+    id_t count = physicalVariablePageId;
+    count_t blockSize = state->eraseSizeInPages;
+    bool validData = false;
+    void *buffer = search->buffer;
+    int8_t moreToRead = count < state->numVarPages && !(readVariablePage(state, physicalVariablePageId));
 
     /*
      * Now we need to find where the page with the smallest key that is still valid.
@@ -956,7 +2359,7 @@ int32_t getMaxError(embedDBState *state, void *buffer) {
         memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
 
         // get slope of keys within page
-        float slope = embedDBCalculateSlope(state, state->buffer);  // this is incorrect, should be buffer. TODO: fix
+        float slope = embedDBCalculateSlope(state, buffer);
 
         for (int i = 0; i < state->maxRecordsPerPage; i++) {
             // loop all keys in page
@@ -976,22 +2379,279 @@ int32_t getMaxError(embedDBState *state, void *buffer) {
             }
         }
 
-        if (maxError > state->maxRecordsPerPage) {
-            return state->maxRecordsPerPage;
-        }
+        if (maxError > state->maxRecordsPerPage) {
+            return state->maxRecordsPerPage;
+        }
+
+        return maxError;
+    }
+}
+
+/**
+ * @brief	Adds an entry for the current page into the search structure
+ * @param	state	embedDB algorithm state structure
+ */
+void indexPage(embedDBState *state, uint32_t pageNumber) {
+    if (EMBEDDB_USING_SPLINE(state->parameters)) {
+        splineAdd(state->spl, embedDBGetMinKey(state, state->buffer), pageNumber);
+    } else if (EMBEDDB_USING_FENCE_POINTERS(state->parameters)) {
+        memcpy((int8_t *)state->fencePointers + (size_t)(pageNumber % state->numDataPages) * state->keySize, embedDBGetMinKey(state, state->buffer), state->keySize);
+    }
+}
+
+/**
+ * @brief	Hashes a key for the Bloom filters. The two halves of the hash are combined to give each hash function's bit.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to hash
+ * @return	64-bit hash of the key
+ */
+static inline uint64_t bloomFilterHash(embedDBState *state, void *key) {
+    uint64_t hash = 0;
+    memcpy(&hash, key, EMBEDDB_KEY_SIZE(state));
+
+    /* Finalizer of splitmix64, so keys that are close together set unrelated bits */
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+/**
+ * @brief	Number of bits each key sets in a Bloom filter. About ln(2) times the bits per key gives the fewest false positives.
+ * @param	state	embedDB algorithm state structure
+ */
+static inline uint8_t bloomFilterNumHashes(embedDBState *state) {
+    uint8_t numHashes = (uint8_t)(state->bloomBitsPerKey * 69 / 100);
+    return numHashes > 0 ? numHashes : 1;
+}
+
+/**
+ * @brief	Builds the Bloom filter of the keys on a data page.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	In memory data page
+ * @param	filter	Space for the filter, bloomFilterSize bytes
+ */
+void buildBloomFilter(embedDBState *state, void *buffer, void *filter) {
+    uint32_t numBits = (uint32_t)state->bloomFilterSize * 8;
+    uint8_t numHashes = bloomFilterNumHashes(state);
+    memset(filter, 0, state->bloomFilterSize);
+
+    count_t count = EMBEDDB_GET_COUNT(buffer);
+    for (count_t i = 0; i < count; i++) {
+        uint64_t hash = bloomFilterHash(state, (int8_t *)buffer + state->headerSize + state->recordSize * i);
+        uint32_t bit = (uint32_t)hash, step = (uint32_t)(hash >> 32) | 1;
+        for (uint8_t j = 0; j < numHashes; j++, bit += step)
+            ((uint8_t *)filter)[(bit % numBits) / 8] |= 1 << (bit % numBits) % 8;
+    }
+}
+
+/**
+ * @brief	Returns the summary of an index page: the id of its first data page, followed by the OR of its data page bitmaps.
+ */
+static inline int8_t *indexSummary(embedDBState *state, id_t indexPageId) {
+    return (int8_t *)state->indexSummaries + (size_t)(indexPageId % state->numIndexPages) * INDEX_SUMMARY_SIZE(state);
+}
+
+static inline id_t summaryFirstPageId(embedDBState *state, id_t indexPageId) {
+    id_t firstPageId;
+    memcpy(&firstPageId, indexSummary(state, indexPageId), sizeof(id_t));
+    return firstPageId;
+}
+
+/**
+ * @brief	Summarizes an index page written to storage.
+ * @param	state				embedDB algorithm state structure
+ * @param	indexPage			Index page
+ * @param	physicalPageNumber	Physical index page the page is stored at
+ */
+void updateIndexSummary(embedDBState *state, void *indexPage, id_t physicalPageNumber) {
+    int8_t *summary = indexSummary(state, physicalPageNumber);
+    memcpy(summary, (int8_t *)indexPage + 8, sizeof(id_t));
+    uint8_t *bitmap = (uint8_t *)summary + sizeof(id_t);
+    memset(bitmap, 0, state->bitmapSize);
+    count_t count = EMBEDDB_GET_COUNT(indexPage);
+    for (count_t i = 0; i < count; i++) {
+        uint8_t *indexRecord = (uint8_t *)indexPage + EMBEDDB_IDX_HEADER_SIZE + (size_t)state->indexRecordSize * i;
+        for (int8_t b = 0; b < state->bitmapSize; b++)
+            bitmap[b] |= indexRecord[b];
+    }
+}
+
+/**
+ * @brief	Finds the stored index page that indexes a data page by binary search over the first data page of each index page summary.
+ * @param	state		embedDB algorithm state structure
+ * @param	pageId		Logical data page id
+ * @param	indexPageId	Set to the logical id of the index page
+ * @return	1 if the data page is on a stored index page, 0 if not
+ */
+int8_t findSummaryIndexPage(embedDBState *state, id_t pageId, id_t *indexPageId) {
+    if (state->nextIdxPageId == state->minIndexPageId || pageId < summaryFirstPageId(state, state->minIndexPageId))
+        return 0;
+    void *writeBuffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_WRITE_BUFFER;
+    if (pageId >= *(id_t *)((int8_t *)writeBuffer + 8))
+        return 0;
+
+    id_t first = state->minIndexPageId, last = state->nextIdxPageId - 1;
+    while (first < last) {
+        id_t mid = first + (last - first + 1) / 2;
+        if (summaryFirstPageId(state, mid) <= pageId)
+            first = mid;
+        else
+            last = mid - 1;
+    }
+    *indexPageId = first;
+    return 1;
+}
+
+/**
+ * @brief	Skips the index pages whose summary bitmap does not overlap a query bitmap, without reading them.
+ * @param	state		embedDB algorithm state structure
+ * @param	queryBitmap	Query bitmap
+ * @param	pageId		Logical data page id to start from
+ * @return	pageId if its index page may match or it is not on a stored index page, otherwise the first data page of the next index page that may match
+ */
+id_t skipIndexPagesBySummary(embedDBState *state, void *queryBitmap, id_t pageId) {
+    id_t indexPageId;
+    if (!findSummaryIndexPage(state, pageId, &indexPageId))
+        return pageId;
+
+    id_t firstIndexPageId = indexPageId;
+    while (indexPageId < state->nextIdxPageId && !pageBitmapMatches(state, queryBitmap, indexSummary(state, indexPageId) + sizeof(id_t)))
+        indexPageId++;
+    if (indexPageId == firstIndexPageId)
+        return pageId;
+    if (indexPageId < state->nextIdxPageId)
+        return summaryFirstPageId(state, indexPageId);
+
+    /* Every stored index page after the data page is ruled out, so continue from the pages in the index write buffer */
+    return *(id_t *)((int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_WRITE_BUFFER + 8);
+}
+
+/**
+ * @brief	Finds the index page holding the record of a data page. The index write buffer and the index page last read are checked first.
+ * 			Otherwise the index page is found by counting back full index pages from the index write buffer,
+ * 			then moving back further for each partial index page written by embedDBFlush.
+ * @param	state		embedDB algorithm state structure
+ * @param	pageId		Logical data page id
+ * @param	indexPage	Set to the buffered index page holding the record if it is found
+ * @param	firstPageId	Set to the logical id of the first data page indexed by that index page
+ * @return	0 if the record was found, 1 if the page has no record in the index, -1 if an index page could not be read
+ */
+int8_t findIndexPage(embedDBState *state, id_t pageId, void **indexPage, id_t *firstPageId) {
+    void *page = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_WRITE_BUFFER;
+    id_t firstId = *(id_t *)((int8_t *)page + 8);
+    if (pageId >= firstId + EMBEDDB_GET_COUNT(page))
+        return 1;
+
+    /* Queries check the pages in order, so the page is usually on the index page last read */
+    void *readBuffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
+    id_t bufferedIndexPageId = *(id_t *)readBuffer;
+    id_t bufferedFirstPageId = *(id_t *)((int8_t *)readBuffer + 8);
+    if (pageId < firstId && state->bufferedIndexPageId != (id_t)-1 && bufferedIndexPageId >= state->minIndexPageId && bufferedIndexPageId < state->nextIdxPageId &&
+        pageId >= bufferedFirstPageId && pageId < bufferedFirstPageId + EMBEDDB_GET_COUNT(readBuffer)) {
+        page = readBuffer;
+        firstId = bufferedFirstPageId;
+    }
+
+    /* The summaries give the index page directly, so no index page is read only to find out how far back to go */
+    id_t summaryIndexPageId;
+    if (pageId < firstId && state->indexSummaries != NULL) {
+        if (!findSummaryIndexPage(state, pageId, &summaryIndexPageId))
+            return 1;
+        if (readIndexPage(state, summaryIndexPageId % state->numIndexPages) != 0) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: Failed to read index page %i (%i)\n", summaryIndexPageId, summaryIndexPageId % state->numIndexPages);
+#endif
+            return -1;
+        }
+        page = readBuffer;
+        firstId = *(id_t *)((int8_t *)page + 8);
+        if (pageId < firstId || pageId >= firstId + EMBEDDB_GET_COUNT(page))
+            return 1;
+    }
+
+    id_t indexPageId = state->nextIdxPageId;
+    while (pageId < firstId) {
+        /* Index pages hold at most maxIdxRecordsPerPage records, so the record is at least this many pages back */
+        id_t pagesBack = (firstId - 1 - pageId) / state->maxIdxRecordsPerPage + 1;
+        if (pagesBack > indexPageId - state->minIndexPageId)
+            return 1;
+        indexPageId -= pagesBack;
 
-        return maxError;
+        if (readIndexPage(state, indexPageId % state->numIndexPages) != 0) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: Failed to read index page %i (%i)\n", indexPageId, indexPageId % state->numIndexPages);
+#endif
+            return -1;
+        }
+        page = readBuffer;
+        firstId = *(id_t *)((int8_t *)page + 8);
+        if (pageId >= firstId + EMBEDDB_GET_COUNT(page))
+            return 1;
     }
+
+    *indexPage = page;
+    *firstPageId = firstId;
+    return 0;
 }
 
 /**
- * @brief	Adds an entry for the current page into the search structure
+ * @brief	Finds the index record of a data page using findIndexPage.
+ * @param	state		embedDB algorithm state structure
+ * @param	pageId		Logical data page id
+ * @param	indexRecord	Set to the index record of the page if it is found
+ * @return	0 if the record was found, 1 if the page has no record in the index, -1 if an index page could not be read
+ */
+int8_t findIndexRecord(embedDBState *state, id_t pageId, void **indexRecord) {
+    void *indexPage = NULL;
+    id_t firstPageId = 0;
+    int8_t found = findIndexPage(state, pageId, &indexPage, &firstPageId);
+    if (found != 0)
+        return found;
+
+    *indexRecord = (int8_t *)indexPage + EMBEDDB_IDX_HEADER_SIZE + state->indexRecordSize * (pageId - firstPageId);
+    return 0;
+}
+
+/**
+ * @brief	Builds the index record of a data page: its bitmap, followed by its min and max data if using zone maps and its Bloom filter if using them.
+ * @param	state		embedDB algorithm state structure
+ * @param	buffer		In memory data page
+ * @param	indexRecord	Space for the record on the index page, indexRecordSize bytes
+ */
+void buildIndexRecord(embedDBState *state, void *buffer, void *indexRecord) {
+    memcpy(indexRecord, EMBEDDB_GET_BITMAP(buffer), state->bitmapSize);
+    if (EMBEDDB_USING_ZONE_MAP(state->parameters))
+        memcpy((int8_t *)indexRecord + state->bitmapSize, EMBEDDB_GET_MIN_DATA(buffer, state), state->dataSize * 2);
+    if (EMBEDDB_USING_BLOOM_FILTER(state->parameters))
+        buildBloomFilter(state, buffer, (int8_t *)indexRecord + state->indexRecordSize - state->bloomFilterSize);
+}
+
+/**
+ * @brief	Checks the Bloom filter of a data page in the index for whether the page can hold a key.
  * @param	state	embedDB algorithm state structure
+ * @param	pageId	Logical data page id
+ * @param	key		Key to check for
+ * @return	1 if the page may hold the key or its filter is not in the index, 0 if it does not, -1 if the index page could not be read
  */
-void indexPage(embedDBState *state, uint32_t pageNumber) {
-    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
-        splineAdd(state->spl, embedDBGetMinKey(state, state->buffer), pageNumber);
+int8_t bloomFilterMayContain(embedDBState *state, id_t pageId, void *key) {
+    void *indexRecord = NULL;
+    int8_t found = findIndexRecord(state, pageId, &indexRecord);
+    if (found != 0)
+        return found;
+
+    uint8_t *filter = (uint8_t *)indexRecord + state->indexRecordSize - state->bloomFilterSize;
+    uint32_t numBits = (uint32_t)state->bloomFilterSize * 8;
+    uint8_t numHashes = bloomFilterNumHashes(state);
+    uint64_t hash = bloomFilterHash(state, key);
+    uint32_t bit = (uint32_t)hash, step = (uint32_t)(hash >> 32) | 1;
+    for (uint8_t j = 0; j < numHashes; j++, bit += step) {
+        if ((filter[(bit % numBits) / 8] & 1 << (bit % numBits) % 8) == 0)
+            return 0;
     }
+    return 1;
 }
 
 /**
@@ -1005,63 +2665,25 @@ int8_t embedDBPut(embedDBState *state, void *key, void *data) {
     /* Copy record into block */
 
     count_t count = EMBEDDB_GET_COUNT(state->buffer);
-    if (state->nextDataPageId > 0 || count > 0) {
-        void *previousKey = NULL;
-        if (count == 0) {
-            readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
-            previousKey = ((int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER) +
-                          (state->recordSize * (state->maxRecordsPerPage - 1)) + state->headerSize;
-        } else {
-            previousKey = (int8_t *)state->buffer + (state->recordSize * (count - 1)) + state->headerSize;
-        }
-        if (state->compareKey(key, previousKey) != 1) {
+    void *previousKey = previousDataKey(state);
+    if (previousKey != NULL && embedDBCompareKeys(state, key, previousKey) != 1) {
 #ifdef PRINT_ERRORS
-            printf("Keys must be strictly ascending order. Insert Failed.\n");
+        printf("Keys must be strictly ascending order. Insert Failed.\n");
 #endif
-            return 1;
-        }
+        return 1;
     }
 
     /* Write current page if full */
     bool wrotePage = false;
     if (count >= state->maxRecordsPerPage) {
-        // As the first buffer is the data write buffer, no manipulation is required
-        id_t pageNum = writePage(state, state->buffer);
-
-        indexPage(state, pageNum);
-
-        /* Save record in index file */
-        if (state->indexFile != NULL) {
-            void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
-            count_t idxcount = EMBEDDB_GET_COUNT(buf);
-            if (idxcount >= state->maxIdxRecordsPerPage) {
-                /* Save index page */
-                writeIndexPage(state, buf);
-
-                idxcount = 0;
-                initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
-
-                /* Add page id to minimum value spot in page */
-                id_t *ptr = (id_t *)((int8_t *)buf + 8);
-                *ptr = pageNum;
-            }
-
-            EMBEDDB_INC_COUNT(buf);
-
-            /* Copy record onto index page */
-            void *bm = EMBEDDB_GET_BITMAP(state->buffer);
-            memcpy((void *)((int8_t *)buf + EMBEDDB_IDX_HEADER_SIZE + state->bitmapSize * idxcount), bm, state->bitmapSize);
-        }
-
-        updateMaxiumError(state, state->buffer);
-
+        if (writeFullDataPage(state) != 0)
+            return -1;
         count = 0;
-        initBufferPage(state, 0);
         wrotePage = true;
     }
 
     /* Copy record onto page */
-    memcpy((int8_t *)state->buffer + (state->recordSize * count) + state->headerSize, key, state->keySize);
+    memcpy((int8_t *)state->buffer + (state->recordSize * count) + state->headerSize, key, EMBEDDB_KEY_SIZE(state));
     memcpy((int8_t *)state->buffer + (state->recordSize * count) + state->headerSize + state->keySize, data, state->dataSize);
 
     /* Copy variable data offset if using variable data*/
@@ -1085,20 +2707,20 @@ int8_t embedDBPut(embedDBState *state, void *key, void *data) {
             /* Since keys are inserted in ascending order, every insert will
              * update max. Min will never change after first record. */
             ptr = EMBEDDB_GET_MAX_KEY(state->buffer, state);
-            memcpy(ptr, key, state->keySize);
+            memcpy(ptr, key, EMBEDDB_KEY_SIZE(state));
 
             ptr = EMBEDDB_GET_MIN_DATA(state->buffer, state);
-            if (state->compareData(data, ptr) < 0)
+            if (embedDBCompareData(state, data, ptr) < 0)
                 memcpy(ptr, data, state->dataSize);
             ptr = EMBEDDB_GET_MAX_DATA(state->buffer, state);
-            if (state->compareData(data, ptr) > 0)
+            if (embedDBCompareData(state, data, ptr) > 0)
                 memcpy(ptr, data, state->dataSize);
         } else {
             /* First record inserted */
             ptr = EMBEDDB_GET_MIN_KEY(state->buffer);
-            memcpy(ptr, key, state->keySize);
+            memcpy(ptr, key, EMBEDDB_KEY_SIZE(state));
             ptr = EMBEDDB_GET_MAX_KEY(state->buffer, state);
-            memcpy(ptr, key, state->keySize);
+            memcpy(ptr, key, EMBEDDB_KEY_SIZE(state));
 
             ptr = EMBEDDB_GET_MIN_DATA(state->buffer, state);
             memcpy(ptr, data, state->dataSize);
@@ -1109,8 +2731,10 @@ int8_t embedDBPut(embedDBState *state, void *key, void *data) {
 
     if (EMBEDDB_USING_BMAP(state->parameters)) {
         /* Update bitmap */
+        if (sampleBitmapValue(state, data) != 0)
+            return -1;
         char *bm = (char *)EMBEDDB_GET_BITMAP(state->buffer);
-        state->updateBitmap(data, bm);
+        embedDBUpdateBitmap(state, data, bm);
     }
 
     /* If using record level consistency, we need to immediately write the updated page to storage */
@@ -1126,6 +2750,168 @@ int8_t embedDBPut(embedDBState *state, void *key, void *data) {
     return 0;
 }
 
+/**
+ * @brief	Puts a batch of records, sorted by key, into structure. Keys must be strictly ascending and greater than every key already inserted.
+ * 			The whole batch is checked before any record is inserted, so a batch out of order inserts nothing.
+ * @param	state		embedDB algorithm state structure
+ * @param	keys		Keys for the records, stored contiguously (numRecords * keySize bytes)
+ * @param	data		Data for the records, stored contiguously (numRecords * dataSize bytes)
+ * @param	numRecords	Number of records in the batch
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBPutBatch(embedDBState *state, void *keys, void *data, uint32_t numRecords) {
+    if (numRecords == 0)
+        return 0;
+
+    int8_t *nextKey = (int8_t *)keys;
+    int8_t *nextData = (int8_t *)data;
+
+    /* Check the ordering of the whole batch up front so the insert loop does not compare keys */
+    void *previousKey = previousDataKey(state);
+    if (previousKey != NULL && embedDBCompareKeys(state, nextKey, previousKey) != 1) {
+#ifdef PRINT_ERRORS
+        printf("Keys must be strictly ascending order. Insert Failed.\n");
+#endif
+        return 1;
+    }
+    for (uint32_t i = 1; i < numRecords; i++) {
+        if (embedDBCompareKeys(state, nextKey + (size_t)i * state->keySize, nextKey + (size_t)(i - 1) * state->keySize) != 1) {
+#ifdef PRINT_ERRORS
+            printf("Keys must be strictly ascending order. Insert Failed.\n");
+#endif
+            return 1;
+        }
+    }
+
+    uint32_t varDataLocation = EMBEDDB_NO_VAR_DATA;
+    uint32_t numRemaining = numRecords;
+    while (numRemaining > 0) {
+        count_t count = EMBEDDB_GET_COUNT(state->buffer);
+        if (count >= state->maxRecordsPerPage) {
+            if (writeFullDataPage(state) != 0)
+                return -1;
+            count = 0;
+
+            if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) && state->nextDataPageId % state->eraseSizeInPages == 0)
+                shiftRecordLevelConsistencyBlocks(state);
+        }
+
+        /* Fill as much of the page as the batch allows */
+        count_t runLength = (count_t)min((uint32_t)(state->maxRecordsPerPage - count), numRemaining);
+        int8_t *record = (int8_t *)state->buffer + state->headerSize + state->recordSize * count;
+        void *minData = nextData;
+        void *maxData = nextData;
+        for (count_t i = 0; i < runLength; i++) {
+            void *recordData = nextData + (size_t)i * state->dataSize;
+            memcpy(record, nextKey + (size_t)i * state->keySize, EMBEDDB_KEY_SIZE(state));
+            memcpy(record + state->keySize, recordData, state->dataSize);
+            if (EMBEDDB_USING_VDATA(state->parameters))
+                memcpy(record + state->keySize + state->dataSize, &varDataLocation, sizeof(uint32_t));
+            record += state->recordSize;
+
+            if (EMBEDDB_USING_MAX_MIN(state->parameters)) {
+                if (embedDBCompareData(state, recordData, minData) < 0)
+                    minData = recordData;
+                if (embedDBCompareData(state, recordData, maxData) > 0)
+                    maxData = recordData;
+            }
+            if (EMBEDDB_USING_BMAP(state->parameters)) {
+                if (state->bitmapSample != NULL) {
+                    /* Learning the buckets rebuilds the page bitmap from the records counted in the header */
+                    EMBEDDB_GET_COUNT(state->buffer) = count + i + 1;
+                    if (sampleBitmapValue(state, recordData) != 0)
+                        return -1;
+                }
+                embedDBUpdateBitmap(state, recordData, EMBEDDB_GET_BITMAP(state->buffer));
+            }
+        }
+
+        /* Update the page header once for the whole run */
+        if (EMBEDDB_USING_MAX_MIN(state->parameters)) {
+            if (count == 0) {
+                memcpy(EMBEDDB_GET_MIN_KEY(state->buffer), nextKey, EMBEDDB_KEY_SIZE(state));
+                memcpy(EMBEDDB_GET_MIN_DATA(state->buffer, state), minData, state->dataSize);
+                memcpy(EMBEDDB_GET_MAX_DATA(state->buffer, state), maxData, state->dataSize);
+            } else {
+                if (embedDBCompareData(state, minData, EMBEDDB_GET_MIN_DATA(state->buffer, state)) < 0)
+                    memcpy(EMBEDDB_GET_MIN_DATA(state->buffer, state), minData, state->dataSize);
+                if (embedDBCompareData(state, maxData, EMBEDDB_GET_MAX_DATA(state->buffer, state)) > 0)
+                    memcpy(EMBEDDB_GET_MAX_DATA(state->buffer, state), maxData, state->dataSize);
+            }
+            memcpy(EMBEDDB_GET_MAX_KEY(state->buffer, state), nextKey + (size_t)(runLength - 1) * state->keySize, EMBEDDB_KEY_SIZE(state));
+        }
+        EMBEDDB_GET_COUNT(state->buffer) = count + runLength;
+
+        nextKey += (size_t)runLength * state->keySize;
+        nextData += (size_t)runLength * state->dataSize;
+        numRemaining -= runLength;
+    }
+
+    /* Record-level consistency only needs the last page of the batch written before returning */
+    if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters))
+        return writeTemporaryPage(state, state->buffer);
+
+    return 0;
+}
+
+/**
+ * @brief	Returns the key of the last record inserted, reading the last data page written if the write buffer is empty.
+ * @param	state	embedDB algorithm state structure
+ * @return	Pointer to the key, or NULL if no record has been inserted
+ */
+void *previousDataKey(embedDBState *state) {
+    count_t count = EMBEDDB_GET_COUNT(state->buffer);
+    if (count > 0)
+        return (int8_t *)state->buffer + (state->recordSize * (count - 1)) + state->headerSize;
+    if (state->nextDataPageId == 0)
+        return NULL;
+
+    readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
+    return ((int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER) +
+           (state->recordSize * (state->maxRecordsPerPage - 1)) + state->headerSize;
+}
+
+/**
+ * @brief	Writes the full data write buffer to storage, adds its bitmap to the index and starts a new page.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t writeFullDataPage(embedDBState *state) {
+    // As the first buffer is the data write buffer, no manipulation is required
+    id_t pageNum = writePage(state, state->buffer);
+    if (pageNum == -1)
+        return -1;
+
+    indexPage(state, pageNum);
+
+    /* Save record in index file */
+    if (state->indexFile != NULL) {
+        void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
+        count_t idxcount = EMBEDDB_GET_COUNT(buf);
+        if (idxcount >= state->maxIdxRecordsPerPage) {
+            /* Save index page */
+            writeIndexPage(state, buf);
+
+            idxcount = 0;
+            initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
+
+            /* Add page id to minimum value spot in page */
+            id_t *ptr = (id_t *)((int8_t *)buf + 8);
+            *ptr = pageNum;
+        }
+
+        EMBEDDB_INC_COUNT(buf);
+
+        /* Copy record onto index page */
+        buildIndexRecord(state, state->buffer, (int8_t *)buf + EMBEDDB_IDX_HEADER_SIZE + state->indexRecordSize * idxcount);
+    }
+
+    updateMaxiumError(state, state->buffer);
+
+    initBufferPage(state, 0);
+    return 0;
+}
+
 int8_t shiftRecordLevelConsistencyBlocks(embedDBState *state) {
     /* erase the record-level consistency blocks */
 
@@ -1148,6 +2934,7 @@ int8_t shiftRecordLevelConsistencyBlocks(embedDBState *state) {
 #endif
             return -1;
         }
+        invalidateBufferedPages(state, state->dataFile, eraseStartingPage, eraseEndingPage);
         eraseStartingPage = eraseEndingPage % state->numDataPages;
     }
 
@@ -1158,7 +2945,7 @@ int8_t shiftRecordLevelConsistencyBlocks(embedDBState *state) {
         state->minDataPageId += state->eraseSizeInPages;
 
         /* remove any spline points related to these pages */
-        if (!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
+        if (EMBEDDB_USING_SPLINE(state->parameters) && !EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
             cleanSpline(state, state->minDataPageId);
         }
     }
@@ -1171,6 +2958,10 @@ int8_t shiftRecordLevelConsistencyBlocks(embedDBState *state) {
 }
 
 void updateMaxiumError(embedDBState *state, void *buffer) {
+    /* Pages with a model store their own error bound */
+    if (EMBEDDB_USING_PAGE_MODEL(state->parameters))
+        return;
+
     // Calculate error within the page
     int32_t maxError = getMaxError(state, buffer);
     if (state->maxError < maxError) {
@@ -1270,6 +3061,101 @@ int8_t embedDBPutVar(embedDBState *state, void *key, void *data, void *variableD
     return 0;
 }
 
+/**
+ * @brief	Returns a key as an offset from the first key on the page. Keys below the first key return 0.
+ */
+static inline uint64_t pageKeyOffset(embedDBState *state, void *buffer, void *key) {
+    uint64_t firstKey = 0, thisKey = 0;
+    memcpy(&firstKey, (int8_t *)buffer + state->headerSize, EMBEDDB_KEY_SIZE(state));
+    memcpy(&thisKey, key, EMBEDDB_KEY_SIZE(state));
+    return thisKey > firstKey ? thisKey - firstKey : 0;
+}
+
+/**
+ * @brief	Predicts the record number of a key offset with a page model, clamped to the records on the page.
+ */
+static inline int16_t predictPageRecord(float intercept, float slope, uint64_t keyOffset, count_t count) {
+    float prediction = intercept + slope * (float)keyOffset;
+    if (prediction < 0)
+        return 0;
+    if (prediction > count - 1)
+        return count - 1;
+    return (int16_t)prediction;
+}
+
+/**
+ * @brief	Fits a linear model from key to record number over the records in a data page and stores it in the page header,
+ * 			along with the largest error of any record on the page.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to in-memory buffer holding the page
+ */
+void fitPageModel(embedDBState *state, void *buffer) {
+    count_t count = EMBEDDB_GET_COUNT(buffer);
+    int8_t *records = (int8_t *)buffer + state->headerSize;
+
+    /* Least squares fit of record number against key offset */
+    double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+    for (count_t i = 0; i < count; i++) {
+        double x = (double)pageKeyOffset(state, buffer, records + state->recordSize * i);
+        sumX += x;
+        sumY += i;
+        sumXX += x * x;
+        sumXY += x * i;
+    }
+    float intercept = 0, slope = 0;
+    double variance = count * sumXX - sumX * sumX;
+    if (count > 1 && variance > 0) {
+        slope = (float)((count * sumXY - sumX * sumY) / variance);
+        if (slope < 0)
+            slope = 0;
+        intercept = (float)((sumY - slope * sumX) / count);
+    }
+
+    /* Measure the error with the same prediction the search uses so the bound is exact */
+    count_t maxError = 0;
+    for (count_t i = 0; i < count; i++) {
+        int16_t prediction = predictPageRecord(intercept, slope, pageKeyOffset(state, buffer, records + state->recordSize * i), count);
+        count_t error = prediction > i ? prediction - i : i - prediction;
+        if (error > maxError)
+            maxError = error;
+    }
+
+    /* Stored plus one so a zeroed header reads as a page without a model */
+    maxError++;
+    int8_t *model = (int8_t *)EMBEDDB_GET_PAGE_MODEL(buffer, state);
+    memcpy(model, &intercept, sizeof(float));
+    memcpy(model + sizeof(float), &slope, sizeof(float));
+    memcpy(model + sizeof(float) * 2, &maxError, sizeof(count_t));
+}
+
+/**
+ * @brief	Narrows the records to search for a key to the error bound of the page model. The range holds the record with
+ * 			the key if it is on the page, and otherwise the last record with a smaller key or the record before the range.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to in-memory buffer holding the page
+ * @param	key		Key for record
+ * @param	first	Set to the first record to search
+ * @param	last	Set to the last record to search
+ * @return	Return 1 if the page has a model, 0 if the whole page must be searched.
+ */
+int8_t pageModelSearchWindow(embedDBState *state, void *buffer, void *key, int16_t *first, int16_t *last) {
+    count_t count = EMBEDDB_GET_COUNT(buffer);
+    int8_t *model = (int8_t *)EMBEDDB_GET_PAGE_MODEL(buffer, state);
+    count_t maxError;
+    memcpy(&maxError, model + sizeof(float) * 2, sizeof(count_t));
+    if (maxError == 0 || count == 0)
+        return 0;
+    maxError--;
+
+    float intercept, slope;
+    memcpy(&intercept, model, sizeof(float));
+    memcpy(&slope, model + sizeof(float), sizeof(float));
+    int16_t prediction = predictPageRecord(intercept, slope, pageKeyOffset(state, buffer, key), count);
+    *first = max(prediction - maxError, 0);
+    *last = min(prediction + maxError, count - 1);
+    return 1;
+}
+
 /**
  * @brief	Given a key, estimates the location of the key within the node.
  * @param	state	embedDB algorithm state structure
@@ -1282,12 +3168,51 @@ int16_t embedDBEstimateKeyLocation(embedDBState *state, void *buffer, void *key)
     float slope = embedDBCalculateSlope(state, buffer);
 
     uint64_t minKey = 0, thisKey = 0;
-    memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
-    memcpy(&thisKey, key, state->keySize);
+    memcpy(&minKey, embedDBGetMinKey(state, buffer), EMBEDDB_KEY_SIZE(state));
+    memcpy(&thisKey, key, EMBEDDB_KEY_SIZE(state));
 
     return (thisKey - minKey) / slope;
 }
 
+#if defined(EMBEDDB_KEY_TYPE)
+/**
+ * @brief	Searches a non-empty node for the key without data-dependent branches. Each step halves the remaining records
+ * 			and picks a half with a conditional move, so a page takes a fixed number of steps and no branch mispredictions.
+ * 			Returns the same record as the binary search in embedDBSearchNode.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to in-memory buffer holding node
+ * @param	key		Key for record
+ * @param	range	1 if range query so return pointer to first record <= key, 0 if exact query so much return first exact match record
+ * @param	first	First record to search
+ * @param	last	Last record to search
+ */
+static inline id_t embedDBSearchNodeBranchless(embedDBState *state, void *buffer, void *key, int8_t range, int16_t first, int16_t last) {
+    int8_t *records = (int8_t *)buffer + state->headerSize;
+    EMBEDDB_KEY_TYPE target, current;
+    memcpy(&target, key, sizeof(EMBEDDB_KEY_TYPE));
+
+    /* Find the number of records from first to last with keys less than the target */
+    int16_t length = last - first + 1;
+    while (length > 1) {
+        int16_t half = length / 2;
+        memcpy(&current, records + state->recordSize * (first + half - 1), sizeof(EMBEDDB_KEY_TYPE));
+        first = current < target ? first + half : first;
+        length -= half;
+    }
+    memcpy(&current, records + state->recordSize * first, sizeof(EMBEDDB_KEY_TYPE));
+    first += current < target;
+
+    if (first < EMBEDDB_GET_COUNT(buffer)) {
+        memcpy(&current, records + state->recordSize * first, sizeof(EMBEDDB_KEY_TYPE));
+        if (current == target)
+            return first;
+    }
+    if (range)
+        return first > 0 ? first - 1 : 0;
+    return -1;
+}
+#endif
+
 /**
  * @brief	Given a key, searches the node for the key. If interior node, returns child record number containing next page id to follow. If leaf node, returns if of first record with that key or (<= key). Returns -1 if key is not found.
  * @param	state	embedDB algorithm state structure
@@ -1301,16 +3226,23 @@ id_t embedDBSearchNode(embedDBState *state, void *buffer, void *key, int8_t rang
     void *mkey;
 
     count = EMBEDDB_GET_COUNT(buffer);
-    middle = embedDBEstimateKeyLocation(state, buffer, key);
+    first = 0;
+    last = count - 1;
+    int8_t usingPageModel = EMBEDDB_USING_PAGE_MODEL(state->parameters) && pageModelSearchWindow(state, buffer, key, &first, &last);
+#if defined(EMBEDDB_KEY_TYPE)
+    if (count > 0)
+        return embedDBSearchNodeBranchless(state, buffer, key, range, first, last);
+#endif
 
-    // check that maxError was calculated and middle is valid (searches full node otherwise)
-    if (state->maxError == -1 || middle >= count || middle <= 0) {
-        first = 0;
-        last = count - 1;
+    if (usingPageModel) {
         middle = (first + last) / 2;
     } else {
-        first = 0;
-        last = count - 1;
+        middle = embedDBEstimateKeyLocation(state, buffer, key);
+
+        // check that maxError was calculated and middle is valid (searches full node otherwise)
+        if (state->maxError == -1 || middle >= count || middle <= 0) {
+            middle = (first + last) / 2;
+        }
     }
 
     if (middle > last) {
@@ -1319,7 +3251,7 @@ id_t embedDBSearchNode(embedDBState *state, void *buffer, void *key, int8_t rang
 
     while (first <= last) {
         mkey = (int8_t *)buffer + state->headerSize + (state->recordSize * middle);
-        compare = state->compareKey(mkey, key);
+        compare = embedDBCompareKeys(state, mkey, key);
         if (compare < 0) {
             first = middle + 1;
         } else if (compare == 0) {
@@ -1335,44 +3267,69 @@ id_t embedDBSearchNode(embedDBState *state, void *buffer, void *key, int8_t rang
 }
 
 /**
- * @brief	Linear search function to be used with an approximate range of pages.
- * 			If the desired key is found, the page containing that record is loaded
- * 			into the passed buffer pointer.
+ * @brief	Searches for the page holding a key within the range of pages the spline gives. Pages are probed 1, 2, 4, ...
+ * 			pages away from the predicted page until the key is passed, then the pages left between the bounds are binary
+ * 			searched, so the number of pages read grows with the log of the distance from the prediction.
+ * 			If the desired key is found, the page containing that record is loaded into the passed buffer pointer.
  * @param	state		embedDB algorithm state structure
- * @param 	numReads	Tracks total number of reads for statistics
  * @param	buf			buffer to store page with desired record
  * @param	key			Key for the record to search for
- * @param	pageId		Page id to start search from
+ * @param	pageId		Page id the spline predicted the record is on
  * @param 	low			Lower bound for the page the record could be found on
  * @param 	high		Uper bound for the page the record could be found on
  * @return	Return 0 if success. Non-zero value if error.
  */
-int8_t linearSearch(embedDBState *state, void *buf, void *key, int32_t pageId, int32_t low, int32_t high) {
-    int32_t pageError = 0;
-    int32_t physPageId;
-    while (1) {
-        /* Move logical page number to physical page id based on location of first data page */
-        physPageId = pageId % state->numDataPages;
+int8_t gallopingSearch(embedDBState *state, void *buf, void *key, int32_t pageId, int32_t low, int32_t high) {
+    int32_t predictedPageId = pageId;
+    int32_t step = 1;
+    int8_t direction = 0;
+    bool passedKey = false;
+
+    /* Only pages still in the data file can hold the record */
+    if (low < (int32_t)state->minDataPageId)
+        low = state->minDataPageId;
+    if (high >= (int32_t)state->nextDataPageId)
+        high = (int32_t)state->nextDataPageId - 1;
 
-        if (pageId > high || pageId < low || low > high || pageId < state->minDataPageId || pageId >= state->nextDataPageId) {
+    while (1) {
+        if (low > high)
             return -1;
+        if (pageId < low) {
+            pageId = low;
+        } else if (pageId > high) {
+            pageId = high;
         }
 
         /* Read page into buffer. If 0 not returned, there was an error */
-        if (readPage(state, physPageId) != 0) {
+        if (readPage(state, pageId % state->numDataPages) != 0) {
             return -1;
         }
 
-        if (state->compareKey(key, embedDBGetMinKey(state, buf)) < 0) { /* Key is less than smallest record in block. */
-            high = --pageId;
-            pageError++;
-        } else if (state->compareKey(key, embedDBGetMaxKey(state, buf)) > 0) { /* Key is larger than largest record in block. */
-            low = ++pageId;
-            pageError++;
+        int8_t move;
+        if (embedDBCompareKeys(state, key, embedDBGetMinKey(state, buf)) < 0) { /* Key is less than smallest record in block. */
+            high = pageId - 1;
+            move = -1;
+        } else if (embedDBCompareKeys(state, key, embedDBGetMaxKey(state, buf)) > 0) { /* Key is larger than largest record in block. */
+            low = pageId + 1;
+            move = 1;
         } else {
             /* Found correct block */
+            id_t pageError = pageId > predictedPageId ? pageId - predictedPageId : predictedPageId - pageId;
+            if (pageError > state->maxSearchPageError)
+                state->maxSearchPageError = pageError;
             return 0;
         }
+
+        /* Double the distance while the key is further in the same direction. Once it has been passed, binary search between the bounds */
+        if (direction != 0 && move != direction)
+            passedKey = true;
+        direction = move;
+        if (passedKey) {
+            pageId = low + (high - low) / 2;
+        } else {
+            pageId += move * step;
+            step *= 2;
+        }
     }
 }
 
@@ -1387,11 +3344,11 @@ int8_t binarySearch(embedDBState *state, void *buffer, void *key) {
         if (first >= last)
             break;
 
-        if (state->compareKey(key, embedDBGetMinKey(state, buffer)) < 0) {
+        if (embedDBCompareKeys(state, key, embedDBGetMinKey(state, buffer)) < 0) {
             /* Key is less than smallest record in block. */
             last = pageId - 1;
             pageId = (first + last) / 2;
-        } else if (state->compareKey(key, embedDBGetMaxKey(state, buffer)) > 0) {
+        } else if (embedDBCompareKeys(state, key, embedDBGetMaxKey(state, buffer)) > 0) {
             /* Key is larger than largest record in block. */
             first = pageId + 1;
             pageId = (first + last) / 2;
@@ -1402,6 +3359,43 @@ int8_t binarySearch(embedDBState *state, void *buffer, void *key) {
     }
 }
 
+/**
+ * @brief	Binary searches the fence pointers for the first page whose smallest key is greater than a key, without reading any pages.
+ * 			A record with the key can only be on the page before it.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @return	Logical id of the first page with a smallest key greater than the key, or nextDataPageId if there is none.
+ */
+id_t fencePointerUpperBound(embedDBState *state, void *key) {
+    id_t first = state->minDataPageId, last = state->nextDataPageId;
+    while (first < last) {
+        id_t middle = first + (last - first) / 2;
+        void *fenceKey = (int8_t *)state->fencePointers + (size_t)(middle % state->numDataPages) * state->keySize;
+        if (embedDBCompareKeys(state, fenceKey, key) <= 0) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+/**
+ * @brief	Reads the only page that can hold a key, found from the fence pointers.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Buffer the page is read into
+ * @param	key		Key to search for
+ * @return	Return 0 if success. Non-zero value if no page can hold the key or the page could not be read.
+ */
+int8_t fencePointerSearch(embedDBState *state, void *buffer, void *key) {
+    id_t pageId = fencePointerUpperBound(state, key);
+    if (pageId == state->minDataPageId)
+        return -1;
+    if (EMBEDDB_USING_BLOOM_FILTER(state->parameters) && bloomFilterMayContain(state, pageId - 1, key) == 0)
+        return -1;
+    return readPage(state, (pageId - 1) % state->numDataPages);
+}
+
 int8_t splineSearch(embedDBState *state, void *buffer, void *key) {
     /* Spline search */
     uint32_t location, lowbound, highbound;
@@ -1421,9 +3415,27 @@ int8_t splineSearch(embedDBState *state, void *buffer, void *key) {
     // Check if the currently buffered page is the correct one
     if (!(lowbound <= state->bufferedPageId &&
           highbound >= state->bufferedPageId &&
-          state->compareKey(embedDBGetMinKey(state, buffer), key) <= 0 &&
-          state->compareKey(embedDBGetMaxKey(state, buffer), key) >= 0)) {
-        if (linearSearch(state, buffer, key, location, lowbound, highbound) == -1) {
+          embedDBCompareKeys(state, embedDBGetMinKey(state, buffer), key) <= 0 &&
+          embedDBCompareKeys(state, embedDBGetMaxKey(state, buffer), key) >= 0)) {
+        /* Narrow the pages to search to the first and last whose Bloom filter may hold the key */
+        if (EMBEDDB_USING_BLOOM_FILTER(state->parameters)) {
+            if (highbound >= state->nextDataPageId)
+                highbound = state->nextDataPageId - 1;
+            while (lowbound <= highbound && bloomFilterMayContain(state, lowbound, key) == 0)
+                lowbound++;
+            if (lowbound > highbound)
+                return -1;
+            while (highbound > lowbound && bloomFilterMayContain(state, highbound, key) == 0)
+                highbound--;
+            location = min(max(location, lowbound), highbound);
+        }
+
+        /* Start reading every page the record could be on so the reads are in flight together.
+         * If the predicted page is cached the record is most likely on it, and the reads would only push cached pages out */
+        if (highbound - lowbound < state->dataPool.numFrames && findFrame(&state->dataPool, state->dataFile, location % state->numDataPages) == NULL) {
+            prefetchDataPages(state, lowbound, min(highbound + 1, state->nextDataPageId));
+        }
+        if (gallopingSearch(state, buffer, key, location, lowbound, highbound) == -1) {
             return -1;
         }
     }
@@ -1477,7 +3489,7 @@ int8_t embedDBGet(embedDBState *state, void *key, void *data) {
     }
 
     uint64_t thisKey = 0;
-    memcpy(&thisKey, key, state->keySize);
+    memcpy(&thisKey, key, EMBEDDB_KEY_SIZE(state));
 
     void *buf = (int8_t *)state->buffer + state->pageSize;
     int16_t numReads = 0;
@@ -1487,8 +3499,8 @@ int8_t embedDBGet(embedDBState *state, void *key, void *data) {
         // get the max/min key from output buffer
         uint64_t bufMaxKey = 0;
         uint64_t bufMinKey = 0;
-        memcpy(&bufMaxKey, embedDBGetMaxKey(state, outputBuffer), state->keySize);
-        memcpy(&bufMinKey, embedDBGetMinKey(state, outputBuffer), state->keySize);
+        memcpy(&bufMaxKey, embedDBGetMaxKey(state, outputBuffer), EMBEDDB_KEY_SIZE(state));
+        memcpy(&bufMinKey, embedDBGetMinKey(state, outputBuffer), EMBEDDB_KEY_SIZE(state));
 
         // return -1 if key is not in buffer
         if (thisKey > bufMaxKey) return -1;
@@ -1503,11 +3515,17 @@ int8_t embedDBGet(embedDBState *state, void *key, void *data) {
     if (EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
         /* Regular binary search */
         searchResult = binarySearch(state, buf, key);
+    } else if (EMBEDDB_USING_FENCE_POINTERS(state->parameters)) {
+        /* Fence pointer search */
+        searchResult = fencePointerSearch(state, buf, key);
     } else {
         /* Spline search */
         searchResult = splineSearch(state, buf, key);
     }
 
+    /* Reads submitted for pages the record was not on must not be left outstanding */
+    waitForSubmittedReads(state);
+
     if (searchResult != 0) {
 #ifdef PRINT_ERRORS
         printf("ERROR: embedDBGet was unable to find page to search for record\n");
@@ -1593,7 +3611,7 @@ void embedDBInitIterator(embedDBState *state, embedDBIterator *it) {
         /* Verify that bitmap index is useful (must have set either min or max data value) */
         if (it->minData != NULL || it->maxData != NULL) {
             it->queryBitmap = calloc(1, state->bitmapSize);
-            state->buildBitmapFromRange(it->minData, it->maxData, it->queryBitmap);
+            embedDBBuildBitmapFromRange(state, it->minData, it->maxData, it->queryBitmap);
         }
     }
 
@@ -1606,7 +3624,11 @@ void embedDBInitIterator(embedDBState *state, embedDBIterator *it) {
 #endif
 
     /* Determine which data page should be the first examined if there is a min key and that we have spline points */
-    if (state->spl->count != 0 && it->minKey != NULL && !(EMBEDDB_USING_BINARY_SEARCH(state->parameters))) {
+    if (EMBEDDB_USING_FENCE_POINTERS(state->parameters) && it->minKey != NULL) {
+        /* Pages before the one that can hold the min key only have smaller keys */
+        id_t upperBound = fencePointerUpperBound(state, it->minKey);
+        it->nextDataPage = upperBound == state->minDataPageId ? upperBound : upperBound - 1;
+    } else if (EMBEDDB_USING_SPLINE(state->parameters) && state->spl->count != 0 && it->minKey != NULL) {
         /* Spline search */
         uint32_t location, lowbound, highbound = 0;
         splineFind(state->spl, it->minKey, state->compareKey, &location, &lowbound, &highbound);
@@ -1617,6 +3639,18 @@ void embedDBInitIterator(embedDBState *state, embedDBIterator *it) {
         it->nextDataPage = state->minDataPageId;
     }
     it->nextDataRec = 0;
+
+    /* The spline also bounds the last page with keys up to the max key, so pages past it are never read ahead */
+    it->endDataPage = UINT32_MAX;
+    if (EMBEDDB_USING_FENCE_POINTERS(state->parameters) && it->maxKey != NULL) {
+        it->endDataPage = fencePointerUpperBound(state, it->maxKey);
+    } else if (EMBEDDB_USING_SPLINE(state->parameters) && state->spl->count != 0 && it->maxKey != NULL) {
+        uint32_t location, lowbound, highbound = 0;
+        splineFind(state->spl, it->maxKey, state->compareKey, &location, &lowbound, &highbound);
+        it->endDataPage = highbound + 1;
+    }
+    it->nextPrefetchPage = it->nextDataPage;
+    it->numPrefetched = 0;
 }
 
 /**
@@ -1668,7 +3702,7 @@ int8_t embedDBFlush(embedDBState *state) {
     // As the first buffer is the data write buffer, no address change is required
     int8_t *buffer = (int8_t *)state->buffer + EMBEDDB_DATA_WRITE_BUFFER * state->pageSize;
     if (EMBEDDB_GET_COUNT(buffer) < 1)
-        return 0;
+        return writeCheckpoints(state);
 
     id_t pageNum = writePage(state, buffer);
     if (pageNum == -1) {
@@ -1685,11 +3719,23 @@ int8_t embedDBFlush(embedDBState *state) {
     if (EMBEDDB_USING_INDEX(state->parameters)) {
         void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
         count_t idxcount = EMBEDDB_GET_COUNT(buf);
+        if (idxcount >= state->maxIdxRecordsPerPage) {
+            /* Save the full index page and start the partial one on a new page */
+            if (writeIndexPage(state, buf) == -1) {
+#ifdef PRINT_ERRORS
+                printf("Failed to write index page during embedDBFlush.");
+#endif
+                return -1;
+            }
+            idxcount = 0;
+            initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
+            id_t *ptr = (id_t *)((int8_t *)buf + 8);
+            *ptr = pageNum;
+        }
         EMBEDDB_INC_COUNT(buf);
 
         /* Copy record onto index page */
-        void *bm = EMBEDDB_GET_BITMAP(state->buffer);
-        memcpy((void *)((int8_t *)buf + EMBEDDB_IDX_HEADER_SIZE + state->bitmapSize * idxcount), bm, state->bitmapSize);
+        buildIndexRecord(state, buffer, (int8_t *)buf + EMBEDDB_IDX_HEADER_SIZE + state->indexRecordSize * idxcount);
 
         id_t writeResult = writeIndexPage(state, buf);
         if (writeResult == -1) {
@@ -1701,8 +3747,10 @@ int8_t embedDBFlush(embedDBState *state) {
 
         state->fileInterface->flush(state->indexFile);
 
-        /* Reinitialize buffer */
+        /* Reinitialize buffer. The next index record is for the next data page written */
         initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
+        id_t *ptr = (id_t *)((int8_t *)buf + 8);
+        *ptr = state->nextDataPageId;
     }
 
     /* Reinitialize buffer */
@@ -1718,9 +3766,140 @@ int8_t embedDBFlush(embedDBState *state) {
             return -1;
         }
     }
+    return writeCheckpoints(state);
+}
+
+/**
+ * @brief	Lists the data pages on an index page that can hold records matching the iterator's query bitmap and, with zone maps, its data range.
+ * 			The query bitmap is ANDed with each index record a 64-bit word at a time rather than a byte at a time.
+ * @param	state			embedDB algorithm state structure
+ * @param	it				embedDB iterator state structure
+ * @param	indexPage		Buffered index page
+ * @param	firstPageId		Logical id of the first data page indexed by the index page
+ * @param	startPageId		First data page to check
+ * @param	candidates		Set to the ids of the data pages that may match, in order
+ * @param	maxCandidates	Maximum number of ids to list
+ * @return	Number of ids listed. Fewer than maxCandidates means no other page on the index page may match
+ */
+count_t indexPageCandidates(embedDBState *state, embedDBIterator *it, void *indexPage, id_t firstPageId, id_t startPageId, id_t *candidates, count_t maxCandidates) {
+    int8_t useZoneMap = EMBEDDB_USING_ZONE_MAP(state->parameters) && (it->minData != NULL || it->maxData != NULL);
+
+    /* Zero padding the last query word ignores the bytes after the bitmap in a full word load */
+    uint64_t queryWords[16] = {0};
+    uint8_t numWords = 0;
+    if (it->queryBitmap != NULL && !EMBEDDB_USING_RANGE_BITMAP(state->parameters)) {
+        numWords = (state->bitmapSize + 7) / 8;
+        memcpy(queryWords, it->queryBitmap, state->bitmapSize);
+    }
+    size_t lastFullLoad = state->pageSize - (size_t)numWords * sizeof(uint64_t);
+
+    count_t numCandidates = 0;
+    count_t count = EMBEDDB_GET_COUNT(indexPage);
+    for (count_t i = startPageId - firstPageId; i < count && numCandidates < maxCandidates; i++) {
+        size_t offset = EMBEDDB_IDX_HEADER_SIZE + (size_t)state->indexRecordSize * i;
+        int8_t *indexRecord = (int8_t *)indexPage + offset;
+
+        if (numWords > 0) {
+            uint64_t overlap = 0;
+            if (offset <= lastFullLoad) {
+                for (uint8_t w = 0; w < numWords; w++) {
+                    uint64_t word;
+                    memcpy(&word, indexRecord + w * sizeof(uint64_t), sizeof(uint64_t));
+                    overlap |= word & queryWords[w];
+                }
+            } else {
+                /* The last records of a full page would load past the end of the page */
+                overlap = bitmapOverlap((uint8_t *)it->queryBitmap, (uint8_t *)indexRecord, state->bitmapSize);
+            }
+            if (overlap == 0)
+                continue;
+        } else if (it->queryBitmap != NULL && !pageBitmapMatches(state, it->queryBitmap, indexRecord)) {
+            continue;
+        }
+
+        /* The page is skipped if its data range does not overlap the query's */
+        if (useZoneMap) {
+            void *pageMinData = indexRecord + state->bitmapSize;
+            void *pageMaxData = (int8_t *)pageMinData + state->dataSize;
+            if (it->minData != NULL && embedDBCompareData(state, pageMaxData, it->minData) < 0)
+                continue;
+            if (it->maxData != NULL && embedDBCompareData(state, pageMinData, it->maxData) > 0)
+                continue;
+        }
+        candidates[numCandidates++] = firstPageId + i;
+    }
+    return numCandidates;
+}
+
+/**
+ * @brief	Finds the first data page from pageId on that can hold records matching the iterator's query, checking a whole index page at a time.
+ * 			Pages without a record in the index may always match.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	pageId	Logical data page id to start from. Set to the first page that may match, or to endPage or later if none before it do
+ * @param	endPage	Data page to stop searching at
+ * @return	0 if success, -1 if an index page could not be read
+ */
+int8_t iteratorNextCandidatePage(embedDBState *state, embedDBIterator *it, id_t *pageId, id_t endPage) {
+    int8_t useZoneMap = EMBEDDB_USING_ZONE_MAP(state->parameters) && (it->minData != NULL || it->maxData != NULL);
+    if ((it->queryBitmap == NULL && !useZoneMap) || state->indexFile == NULL)
+        return 0;
+
+    while (*pageId < endPage) {
+        if (it->queryBitmap != NULL && state->indexSummaries != NULL) {
+            *pageId = skipIndexPagesBySummary(state, it->queryBitmap, *pageId);
+            if (*pageId >= endPage)
+                return 0;
+        }
+
+        void *indexPage = NULL;
+        id_t firstPageId = 0;
+        int8_t found = findIndexPage(state, *pageId, &indexPage, &firstPageId);
+        if (found != 0)
+            return found == 1 ? 0 : -1;
+
+        if (indexPageCandidates(state, it, indexPage, firstPageId, *pageId, pageId, 1) == 1)
+            return 0;
+        *pageId = firstPageId + EMBEDDB_GET_COUNT(indexPage);
+    }
     return 0;
 }
 
+/**
+ * @brief	Submits reads for the next data pages the iterator will read, so they are in flight while the current page is filtered.
+ * 			Pages ruled out by the bitmap index or past the spline bound for the max key are skipped, and at most readAheadDepth pages are kept ahead of the iterator.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure, at the start of the page it is about to read
+ */
+void prefetchIteratorPages(embedDBState *state, embedDBIterator *it) {
+    if (state->fileInterface->submitRead == NULL)
+        return;
+
+    if (it->nextPrefetchPage <= it->nextDataPage) {
+        it->nextPrefetchPage = it->nextDataPage + 1;
+        it->numPrefetched = 0;
+    } else if (it->numPrefetched > 0) {
+        /* The iterator only stops on pages that may match, which are the pages that were read ahead */
+        it->numPrefetched--;
+    }
+
+    /* Leave a frame for the page the iterator is about to read so it does not evict a page read ahead of it */
+    count_t depth = state->dataPool.numFrames == 0 ? 0 : min(readAheadDepth(state, &state->dataPool), state->dataPool.numFrames - 1);
+    uint32_t endPage = min(it->endDataPage, state->nextDataPageId);
+    while (it->numPrefetched < depth && it->nextPrefetchPage < endPage) {
+        id_t pageId = it->nextPrefetchPage;
+        if (iteratorNextCandidatePage(state, it, &pageId, endPage) != 0)
+            return;
+        it->nextPrefetchPage = pageId;
+        if (pageId >= endPage)
+            return;
+        if (submitPageRead(state, state->dataFile, pageId % state->numDataPages) != 0)
+            return;
+        it->numPrefetched++;
+        it->nextPrefetchPage++;
+    }
+}
+
 /**
  * @brief	Return next key, data pair for iterator.
  * @param	state	embedDB algorithm state structure
@@ -1730,43 +3909,48 @@ int8_t embedDBFlush(embedDBState *state) {
  * @return	1 if successful, 0 if no more records
  */
 int8_t embedDBNext(embedDBState *state, embedDBIterator *it, void *key, void *data) {
+    int8_t hasRecord = iteratorNextRecord(state, it, key, data);
+
+    /* Pages read ahead of time are no longer needed once the scan ends, so do not leave reads into the buffer outstanding */
+    if (!hasRecord)
+        waitForSubmittedReads(state);
+    return hasRecord;
+}
+
+/**
+ * @brief	Finds the next record matching the iterator. Used by embedDBNext.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t iteratorNextRecord(embedDBState *state, embedDBIterator *it, void *key, void *data) {
     int searchWriteBuf = 0;
     while (1) {
         if (it->nextDataPage > state->nextDataPageId) {
             return 0;
         }
-        if (it->nextDataPage == state->nextDataPageId) {
-            searchWriteBuf = 1;
-        }
-
-        // If we are just starting to read a new page and we have a query bitmap
-        if (it->nextDataRec == 0 && it->queryBitmap != NULL) {
-            // Find what index page determines if we should read the data page
-            uint32_t indexPage = it->nextDataPage / state->maxIdxRecordsPerPage;
-            uint16_t indexRec = it->nextDataPage % state->maxIdxRecordsPerPage;
-
-            if (state->indexFile != NULL && indexPage >= state->minIndexPageId && indexPage < state->nextIdxPageId) {
-                // If the index page that contains this data page exists, else we must read the data page regardless cause we don't have the index saved for it
-
-                if (readIndexPage(state, indexPage % state->numIndexPages) != 0) {
-#ifdef PRINT_ERRORS
-                    printf("ERROR: Failed to read index page %i (%i)\n", indexPage, indexPage % state->numIndexPages);
-#endif
-                    return 0;
-                }
-
-                // Get bitmap for data page in question
-                void *indexBM = (int8_t *)state->buffer + EMBEDDB_INDEX_READ_BUFFER * state->pageSize + EMBEDDB_IDX_HEADER_SIZE + indexRec * state->bitmapSize;
+        if (it->nextDataPage == state->nextDataPageId) {
+            searchWriteBuf = 1;
+        }
 
-                // Determine if we should read the data page
-                if (!bitmapOverlap(it->queryBitmap, indexBM, state->bitmapSize)) {
-                    // Do not read this data page, try the next one
-                    it->nextDataPage++;
-                    continue;
-                }
+        // If we are just starting to read a new page, use the index to jump to the next data page that may match
+        if (it->nextDataRec == 0 && searchWriteBuf == 0) {
+            id_t pageId = it->nextDataPage;
+            if (iteratorNextCandidatePage(state, it, &pageId, state->nextDataPageId) != 0)
+                return 0;
+            if (pageId != it->nextDataPage) {
+                it->nextDataPage = pageId;
+                continue;
             }
         }
 
+        /* Have the reads for the following pages in flight while this page is filtered */
+        if (searchWriteBuf == 0 && it->nextDataRec == 0) {
+            prefetchIteratorPages(state, it);
+        }
+
         if (searchWriteBuf == 0 && readPage(state, it->nextDataPage % state->numDataPages) != 0) {
 #ifdef PRINT_ERRORS
             printf("ERROR: Failed to read data page %i (%i)\n", it->nextDataPage, it->nextDataPage % state->numDataPages);
@@ -1779,18 +3963,18 @@ int8_t embedDBNext(embedDBState *state, embedDBIterator *it, void *key, void *da
         uint32_t pageRecordCount = EMBEDDB_GET_COUNT(buf);
         while (it->nextDataRec < pageRecordCount) {
             // Get record
-            memcpy(key, buf + state->headerSize + it->nextDataRec * state->recordSize, state->keySize);
+            memcpy(key, buf + state->headerSize + it->nextDataRec * state->recordSize, EMBEDDB_KEY_SIZE(state));
             memcpy(data, buf + state->headerSize + it->nextDataRec * state->recordSize + state->keySize, state->dataSize);
             it->nextDataRec++;
 
             // Check record
-            if (it->minKey != NULL && state->compareKey(key, it->minKey) < 0)
+            if (it->minKey != NULL && embedDBCompareKeys(state, key, it->minKey) < 0)
                 continue;
-            if (it->maxKey != NULL && state->compareKey(key, it->maxKey) > 0)
+            if (it->maxKey != NULL && embedDBCompareKeys(state, key, it->maxKey) > 0)
                 return 0;
-            if (it->minData != NULL && state->compareData(data, it->minData) < 0)
+            if (it->minData != NULL && embedDBCompareData(state, data, it->minData) < 0)
                 continue;
-            if (it->maxData != NULL && state->compareData(data, it->maxData) > 0)
+            if (it->maxData != NULL && embedDBCompareData(state, data, it->maxData) > 0)
                 continue;
 
             // If we make it here, the record matches the query
@@ -1868,7 +4052,7 @@ int8_t embedDBSetupVarDataStream(embedDBState *state, void *key, embedDBVarDataS
     }
 
     // Check if the variable data associated with this key has been overwritten due to file wrap around
-    if (state->compareKey(key, &state->minVarRecordId) < 0) {
+    if (embedDBCompareKeys(state, key, &state->minVarRecordId) < 0) {
         *varData = NULL;
         return 1;
     }
@@ -1979,9 +4163,18 @@ void embedDBPrintStats(embedDBState *state) {
     printf("Num writes: %d\n", state->numWrites);
     printf("Num index reads: %d\n", state->numIdxReads);
     printf("Num index writes: %d\n", state->numIdxWrites);
+    if (state->dataPool.numFrames > 0) {
+        printf("Buffer pool hits: %d misses: %d\n", state->dataPool.hits, state->dataPool.misses);
+    }
+    if (state->indexPool.numFrames > 0) {
+        printf("Index buffer pool hits: %d misses: %d\n", state->indexPool.hits, state->indexPool.misses);
+    }
     printf("Max Error: %d\n", state->maxError);
+    if (EMBEDDB_USING_SPLINE(state->parameters)) {
+        printf("Max search page error: %d\n", state->maxSearchPageError);
+    }
 
-    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+    if (EMBEDDB_USING_SPLINE(state->parameters)) {
         splinePrint(state->spl);
     }
 }
@@ -1996,6 +4189,10 @@ id_t writePage(embedDBState *state, void *buffer) {
     if (state->dataFile == NULL)
         return -1;
 
+    /* Erase pages to make space for new data, unless embedDBMaintenance already has */
+    if (state->numAvailDataPages <= 0 && eraseNextDataBlock(state) != 0)
+        return -1;
+
     /* Always writes to next page number. Returned to user. */
     id_t pageNum = state->nextDataPageId++;
     id_t physicalPageNum = pageNum % state->numDataPages;
@@ -2003,27 +4200,11 @@ id_t writePage(embedDBState *state, void *buffer) {
     /* Setup page number in header */
     memcpy(buffer, &(pageNum), sizeof(id_t));
 
-    if (state->numAvailDataPages <= 0) {
-        /* Erase pages to make space for new data */
-        int8_t eraseResult = state->fileInterface->erase(physicalPageNum, physicalPageNum + state->eraseSizeInPages, state->pageSize, state->dataFile);
-        if (eraseResult != 1) {
-#ifdef PRINT_ERRORS
-            printf("Failed to erase data page: %i (%i)\n", pageNum, physicalPageNum);
-#endif
-            return -1;
-        }
-
-        /* Flag the pages as usable to EmbedDB */
-        state->numAvailDataPages += state->eraseSizeInPages;
-        state->minDataPageId += state->eraseSizeInPages;
-
-        /* remove any spline points related to these pages */
-        if (!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
-            cleanSpline(state, state->minDataPageId);
-        }
-    }
+    if (EMBEDDB_USING_PAGE_MODEL(state->parameters))
+        fitPageModel(state, buffer);
 
     /* Seek to page location in file */
+    invalidateBufferedPages(state, state->dataFile, physicalPageNum, physicalPageNum + 1);
     int32_t val = state->fileInterface->write(buffer, physicalPageNum, state->pageSize, state->dataFile);
     if (val == 0) {
 #ifdef PRINT_ERRORS
@@ -2077,9 +4258,11 @@ int8_t writeTemporaryPage(embedDBState *state, void *buffer) {
             return -2;
 #endif
         }
+        invalidateBufferedPages(state, state->dataFile, eraseStartingPage, eraseEndingPage);
     }
 
     /* Write temporary page to storage */
+    invalidateBufferedPages(state, state->dataFile, state->nextRLCPhysicalPageLocation, state->nextRLCPhysicalPageLocation + 1);
     int8_t writeSuccess = state->fileInterface->write(buffer, state->nextRLCPhysicalPageLocation++, state->pageSize, state->dataFile);
     if (!writeSuccess) {
 #ifdef PRINT_ERRORS
@@ -2128,6 +4311,10 @@ id_t writeIndexPage(embedDBState *state, void *buffer) {
     if (state->indexFile == NULL)
         return -1;
 
+    // Erase index pages to make room for new page, unless embedDBMaintenance already has
+    if (state->numAvailIndexPages <= 0 && eraseNextIndexBlock(state) != 0)
+        return -1;
+
     /* Always writes to next page number. Returned to user. */
     id_t pageNum = state->nextIdxPageId++;
     id_t physicalPageNumber = pageNum % state->numIndexPages;
@@ -2135,20 +4322,8 @@ id_t writeIndexPage(embedDBState *state, void *buffer) {
     /* Setup page number in header */
     memcpy(buffer, &(pageNum), sizeof(id_t));
 
-    if (state->numAvailIndexPages <= 0) {
-        // Erase index pages to make room for new page
-        int8_t eraseResult = state->fileInterface->erase(physicalPageNumber, physicalPageNumber + state->eraseSizeInPages, state->pageSize, state->indexFile);
-        if (eraseResult != 1) {
-#ifdef PRINT_ERRORS
-            printf("Failed to erase data page: %i (%i)\n", pageNum, physicalPageNumber);
-#endif
-            return -1;
-        }
-        state->numAvailIndexPages += state->eraseSizeInPages;
-        state->minIndexPageId += state->eraseSizeInPages;
-    }
-
     /* Seek to page location in file */
+    invalidateBufferedPages(state, state->indexFile, physicalPageNumber, physicalPageNumber + 1);
     int32_t val = state->fileInterface->write(buffer, physicalPageNumber, state->pageSize, state->indexFile);
     if (val == 0) {
 #ifdef PRINT_ERRORS
@@ -2157,6 +4332,12 @@ id_t writeIndexPage(embedDBState *state, void *buffer) {
         return -1;
     }
 
+    /* A pinned index pool must hold every page, so keep a copy of the new page instead of reading it back later */
+    if (state->indexPool.pinned)
+        cachePage(state, &state->indexPool, state->indexFile, physicalPageNumber, buffer);
+    if (state->indexSummaries != NULL)
+        updateIndexSummary(state, buffer, physicalPageNumber);
+
     state->numAvailIndexPages--;
     state->numIdxWrites++;
 
@@ -2177,33 +4358,16 @@ id_t writeVariablePage(embedDBState *state, void *buffer) {
     // Make sure the address being witten to wraps around
     id_t physicalPageId = state->nextVarPageId % state->numVarPages;
 
-    // Erase data if needed
-    if (state->numAvailVarPages <= 0) {
-        int8_t eraseResult = state->fileInterface->erase(physicalPageId, physicalPageId + state->eraseSizeInPages, state->pageSize, state->varFile);
-        if (eraseResult != 1) {
-#ifdef PRINT_ERRORS
-            printf("Failed to erase data page: %i (%i)\n", state->nextVarPageId, physicalPageId);
-#endif
-            return -1;
-        }
-        state->numAvailVarPages += state->eraseSizeInPages;
-        // Last page that is deleted
-        id_t pageNum = (physicalPageId + state->eraseSizeInPages - 1) % state->numVarPages;
-
-        // Read in that page so we can update which records we still have the data for
-        if (readVariablePage(state, pageNum) != 0) {
-            return -1;
-        }
-        void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters) + sizeof(id_t);
-        memcpy(&state->minVarRecordId, buf, state->keySize);
-        state->minVarRecordId += 1;  // Add one because the result from the last line is a record that is erased
-    }
+    // Erase data if needed, unless embedDBMaintenance already has
+    if (state->numAvailVarPages <= 0 && eraseNextVarBlock(state) != 0)
+        return -1;
 
     // Add logical page number to data page
     void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_WRITE_BUFFER(state->parameters);
     memcpy(buf, &state->nextVarPageId, sizeof(id_t));
 
     // Write to file
+    invalidateBufferedPages(state, state->varFile, physicalPageId, physicalPageId + 1);
     uint32_t val = state->fileInterface->write(buffer, physicalPageId, state->pageSize, state->varFile);
     if (val == 0) {
 #ifndef PRINT
@@ -2219,6 +4383,105 @@ id_t writeVariablePage(embedDBState *state, void *buffer) {
     return state->nextVarPageId - 1;
 }
 
+/**
+ * @brief	Erases the oldest block of the data file, which holds the next page to be written, and removes the spline points for it.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t eraseNextDataBlock(embedDBState *state) {
+    id_t physicalPageNum = state->nextDataPageId % state->numDataPages;
+    int8_t eraseResult = state->fileInterface->erase(physicalPageNum, physicalPageNum + state->eraseSizeInPages, state->pageSize, state->dataFile);
+    if (eraseResult != 1) {
+#ifdef PRINT_ERRORS
+        printf("Failed to erase data page: %i (%i)\n", state->nextDataPageId, physicalPageNum);
+#endif
+        return -1;
+    }
+    invalidateBufferedPages(state, state->dataFile, physicalPageNum, physicalPageNum + state->eraseSizeInPages);
+
+    /* Flag the pages as usable to EmbedDB */
+    state->numAvailDataPages += state->eraseSizeInPages;
+    state->minDataPageId += state->eraseSizeInPages;
+
+    /* remove any spline points related to these pages */
+    if (EMBEDDB_USING_SPLINE(state->parameters) && !EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
+        cleanSpline(state, state->minDataPageId);
+    }
+    return 0;
+}
+
+/**
+ * @brief	Erases the oldest block of the index file, which holds the next index page to be written.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t eraseNextIndexBlock(embedDBState *state) {
+    id_t physicalPageNumber = state->nextIdxPageId % state->numIndexPages;
+    int8_t eraseResult = state->fileInterface->erase(physicalPageNumber, physicalPageNumber + state->eraseSizeInPages, state->pageSize, state->indexFile);
+    if (eraseResult != 1) {
+#ifdef PRINT_ERRORS
+        printf("Failed to erase index page: %i (%i)\n", state->nextIdxPageId, physicalPageNumber);
+#endif
+        return -1;
+    }
+    invalidateBufferedPages(state, state->indexFile, physicalPageNumber, physicalPageNumber + state->eraseSizeInPages);
+    state->numAvailIndexPages += state->eraseSizeInPages;
+    state->minIndexPageId += state->eraseSizeInPages;
+    return 0;
+}
+
+/**
+ * @brief	Erases the oldest block of the variable data file, which holds the next variable data page to be written, and updates the smallest key that still has variable data.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t eraseNextVarBlock(embedDBState *state) {
+    id_t physicalPageId = state->nextVarPageId % state->numVarPages;
+
+    // Read in the last page that is deleted before erasing it so we can update which records we still have the data for
+    id_t pageNum = (physicalPageId + state->eraseSizeInPages - 1) % state->numVarPages;
+    if (readVariablePage(state, pageNum) != 0) {
+        return -1;
+    }
+    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters) + sizeof(id_t);
+    uint64_t minVarRecordId = 0;
+    memcpy(&minVarRecordId, buf, state->keySize);
+
+    int8_t eraseResult = state->fileInterface->erase(physicalPageId, physicalPageId + state->eraseSizeInPages, state->pageSize, state->varFile);
+    if (eraseResult != 1) {
+#ifdef PRINT_ERRORS
+        printf("Failed to erase variable data page: %i (%i)\n", state->nextVarPageId, physicalPageId);
+#endif
+        return -1;
+    }
+    invalidateBufferedPages(state, state->varFile, physicalPageId, physicalPageId + state->eraseSizeInPages);
+
+    /* The variable read buffer holds a page that no longer exists */
+    state->bufferedVarPage = -1;
+    state->numAvailVarPages += state->eraseSizeInPages;
+    state->minVarRecordId = minVarRecordId + 1;  // Add one because the result from the last line is a record that is erased
+    return 0;
+}
+
+/**
+ * @brief	Does work that would otherwise stall the next insert. If a file is full, its oldest block is erased now instead of by the next page written to it.
+ * @param	state	algorithm state structure
+ * @returns 0 if successul and a non-zero value otherwise
+ */
+int8_t embedDBMaintenance(embedDBState *state) {
+    /* With record-level consistency, the data blocks are erased as the record-level consistency blocks move forward */
+    if (!EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) && state->numAvailDataPages <= 0 && eraseNextDataBlock(state) != 0)
+        return -1;
+
+    if (EMBEDDB_USING_INDEX(state->parameters) && state->numAvailIndexPages <= 0 && eraseNextIndexBlock(state) != 0)
+        return -1;
+
+    if (EMBEDDB_USING_VDATA(state->parameters) && state->numAvailVarPages <= 0 && eraseNextVarBlock(state) != 0)
+        return -1;
+
+    return 0;
+}
+
 /**
  * @brief	Memcopies write buffer to the read buffer.
  * @param	state	embedDB algorithm state structure
@@ -2245,6 +4508,403 @@ void readToWriteBufVar(embedDBState *state) {
     memcpy(readBuf, writeBuf, state->pageSize);
 }
 
+/**
+ * @brief	Sets up an empty buffer pool over the given buffer space.
+ * @param	pool		Buffer pool to set up
+ * @param	pages		Buffer space for the pool. Must hold numFrames pages
+ * @param	numFrames	Number of pages in the pool
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t initBufferPool(embedDBBufferPool *pool, void *pages, count_t numFrames) {
+    pool->pages = pages;
+    pool->frames = NULL;
+    pool->buckets = NULL;
+    pool->numFrames = 0;
+    pool->clockHand = 0;
+    pool->hits = 0;
+    pool->misses = 0;
+    pool->pinned = 0;
+    if (numFrames == 0)
+        return 0;
+
+    pool->frames = calloc(numFrames, sizeof(embedDBFrame));
+    pool->buckets = malloc(numFrames * sizeof(count_t));
+    if (pool->frames == NULL || pool->buckets == NULL) {
+        closeBufferPool(pool);
+        return -1;
+    }
+
+    for (count_t i = 0; i < numFrames; i++) {
+        pool->buckets[i] = EMBEDDB_NO_FRAME;
+    }
+    pool->numFrames = numFrames;
+    return 0;
+}
+
+/**
+ * @brief	Frees the frames of a buffer pool. The buffer space belongs to the caller and is not freed.
+ * @param	pool	Buffer pool to close
+ */
+void closeBufferPool(embedDBBufferPool *pool) {
+    free(pool->frames);
+    free(pool->buckets);
+    pool->frames = NULL;
+    pool->buckets = NULL;
+    pool->numFrames = 0;
+}
+
+/**
+ * @brief	Returns the buffer pool that caches pages of a file.
+ * @param	state	embedDB algorithm state structure
+ * @param	file	File the pages belong to
+ * @return	The buffer pool for the file
+ */
+embedDBBufferPool *bufferPoolForFile(embedDBState *state, void *file) {
+    if (file == state->indexFile && state->indexPool.numFrames > 0)
+        return &state->indexPool;
+    return &state->dataPool;
+}
+
+/**
+ * @brief	Returns the buffer page used by a frame.
+ * @param	state	embedDB algorithm state structure
+ * @param	pool	Buffer pool the frame belongs to
+ * @param	frame	Frame to get the buffer page of
+ * @return	Pointer to the start of the buffer page
+ */
+void *frameBuffer(embedDBState *state, embedDBBufferPool *pool, embedDBFrame *frame) {
+    return (int8_t *)pool->pages + (size_t)state->pageSize * (frame - pool->frames);
+}
+
+/**
+ * @brief	Finds the frame holding a page, including pages whose read has been submitted but not finished.
+ * @param	pool	Buffer pool to search
+ * @param	file	File the page belongs to
+ * @param	pageNum	Physical page number
+ * @return	The frame holding the page, NULL if no frame holds it
+ */
+embedDBFrame *findFrame(embedDBBufferPool *pool, void *file, id_t pageNum) {
+    if (pool->numFrames == 0)
+        return NULL;
+
+    count_t i = pool->buckets[pageNum % pool->numFrames];
+    while (i != EMBEDDB_NO_FRAME) {
+        embedDBFrame *frame = &pool->frames[i];
+        if (frame->file == file && frame->pageId == pageNum)
+            return frame;
+        i = frame->nextInBucket;
+    }
+    return NULL;
+}
+
+/**
+ * @brief	Records that a frame holds a page so findFrame can find it.
+ * @param	pool	Buffer pool the frame belongs to
+ * @param	frame	Empty frame
+ * @param	file	File the page belongs to
+ * @param	pageNum	Physical page number
+ * @param	status	EMBEDDB_FRAME_READING, EMBEDDB_FRAME_FILLING or EMBEDDB_FRAME_VALID
+ */
+void assignFrame(embedDBBufferPool *pool, embedDBFrame *frame, void *file, id_t pageNum, uint8_t status) {
+    count_t *bucket = &pool->buckets[pageNum % pool->numFrames];
+    frame->file = file;
+    frame->pageId = pageNum;
+    frame->status = status;
+    frame->nextInBucket = *bucket;
+    *bucket = frame - pool->frames;
+}
+
+/**
+ * @brief	Empties a frame. Any read into the frame must have finished.
+ * @param	pool	Buffer pool the frame belongs to
+ * @param	frame	Frame to empty
+ */
+void releaseFrame(embedDBBufferPool *pool, embedDBFrame *frame) {
+    if (frame->status == EMBEDDB_FRAME_EMPTY)
+        return;
+
+    count_t frameNum = frame - pool->frames;
+    count_t *link = &pool->buckets[frame->pageId % pool->numFrames];
+    while (*link != frameNum) {
+        link = &pool->frames[*link].nextInBucket;
+    }
+    *link = frame->nextInBucket;
+
+    frame->file = NULL;
+    frame->status = EMBEDDB_FRAME_EMPTY;
+    frame->useCount = 0;
+}
+
+/**
+ * @brief	Picks a frame to reuse with the CLOCK policy. Each pass of the clock hand lowers a frame's use count and the first frame
+ * 			found at zero is reused, so pages that are read repeatedly stay in the pool while pages read once are reused first.
+ * 			If a read into the frame is still outstanding it is waited for first. Pinned pools only hand out empty frames.
+ * @param	state	embedDB algorithm state structure
+ * @param	pool	Buffer pool to pick from. At least one frame must not be EMBEDDB_FRAME_FILLING, and one must be empty if the pool is pinned
+ * @return	An empty frame
+ */
+embedDBFrame *allocateFrame(embedDBState *state, embedDBBufferPool *pool) {
+    while (1) {
+        embedDBFrame *frame = &pool->frames[pool->clockHand];
+        pool->clockHand = (pool->clockHand + 1) % pool->numFrames;
+        if (frame->status == EMBEDDB_FRAME_FILLING || (pool->pinned && frame->status != EMBEDDB_FRAME_EMPTY))
+            continue;
+        if (frame->useCount > 0) {
+            frame->useCount--;
+            continue;
+        }
+
+        completePageRead(state, pool, frame);
+        releaseFrame(pool, frame);
+        return frame;
+    }
+}
+
+/**
+ * @brief	Finds a frame that can be reused without evicting a page that is read repeatedly. Unlike allocateFrame, use counts are
+ * 			not lowered and frames with a read in flight are never picked, so pages read ahead of time can not push out the pages being worked on.
+ * 			Empty frames and pages that were never used are picked before pages used once.
+ * @param	pool	Buffer pool to pick from
+ * @return	An empty frame, NULL if every frame holds a page in use
+ */
+embedDBFrame *findUnusedFrame(embedDBBufferPool *pool) {
+    for (uint8_t maxUseCount = 0; maxUseCount <= 1; maxUseCount++) {
+        for (count_t i = 0; i < pool->numFrames; i++) {
+            embedDBFrame *frame = &pool->frames[pool->clockHand];
+            pool->clockHand = (pool->clockHand + 1) % pool->numFrames;
+            if (frame->status == EMBEDDB_FRAME_EMPTY || (!pool->pinned && frame->status == EMBEDDB_FRAME_VALID && frame->useCount <= maxUseCount)) {
+                releaseFrame(pool, frame);
+                return frame;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief	Copies a page into a free frame of the pool. The pool must not already hold the page.
+ * @param	state	embedDB algorithm state structure
+ * @param	pool	Buffer pool to add the page to
+ * @param	file	File the page belongs to
+ * @param	pageNum	Physical page number
+ * @param	buffer	Page to copy
+ */
+void cachePage(embedDBState *state, embedDBBufferPool *pool, void *file, id_t pageNum, void *buffer) {
+    embedDBFrame *frame = allocateFrame(state, pool);
+    assignFrame(pool, frame, file, pageNum, EMBEDDB_FRAME_VALID);
+    memcpy(frameBuffer(state, pool, frame), buffer, state->pageSize);
+}
+
+/**
+ * @brief	Starts reading a page into a frame without waiting for it, if the file interface supports asynchronous reads.
+ * 			The page is later taken from the frame by readPageFromFile.
+ * @param	state	embedDB algorithm state structure
+ * @param	file	File to read from
+ * @param	pageNum	Physical page number to read
+ * @return	Return 0 if the page is buffered or being read, -1 if the read could not be submitted.
+ */
+int8_t submitPageRead(embedDBState *state, void *file, id_t pageNum) {
+    embedDBBufferPool *pool = bufferPoolForFile(state, file);
+    if (state->fileInterface->submitRead == NULL || pool->numFrames == 0)
+        return -1;
+
+    if (findFrame(pool, file, pageNum) != NULL)
+        return 0;
+
+    embedDBFrame *frame = findUnusedFrame(pool);
+    if (frame == NULL || !state->fileInterface->submitRead(frameBuffer(state, pool, frame), pageNum, state->pageSize, file))
+        return -1;
+
+    assignFrame(pool, frame, file, pageNum, EMBEDDB_FRAME_READING);
+    if (file == state->indexFile) {
+        state->numIdxReads++;
+    } else {
+        state->numReads++;
+    }
+    return 0;
+}
+
+/**
+ * @brief	Waits for a submitted read into the frame to finish. Does nothing if no read is outstanding.
+ * @param	state	embedDB algorithm state structure
+ * @param	pool	Buffer pool the frame belongs to
+ * @param	frame	Frame to wait for
+ * @return	Return 0 if success, -1 if the read failed. The frame is emptied if the read failed.
+ */
+int8_t completePageRead(embedDBState *state, embedDBBufferPool *pool, embedDBFrame *frame) {
+    if (frame->status != EMBEDDB_FRAME_READING)
+        return 0;
+
+    if (state->fileInterface->waitRead(frameBuffer(state, pool, frame), frame->file)) {
+        frame->status = EMBEDDB_FRAME_VALID;
+        return 0;
+    }
+
+    releaseFrame(pool, frame);
+    return -1;
+}
+
+/**
+ * @brief	Waits for all submitted reads to finish, so no reads into the buffer are outstanding.
+ * @param	state	embedDB algorithm state structure
+ */
+void waitForSubmittedReads(embedDBState *state) {
+    if (state->fileInterface->submitRead == NULL)
+        return;
+
+    for (count_t i = 0; i < state->dataPool.numFrames; i++) {
+        completePageRead(state, &state->dataPool, &state->dataPool.frames[i]);
+    }
+    for (count_t i = 0; i < state->indexPool.numFrames; i++) {
+        completePageRead(state, &state->indexPool, &state->indexPool.frames[i]);
+    }
+}
+
+/**
+ * @brief	Returns how many pages may be read ahead into a buffer pool. This is the whole pool unless EMBEDDB_LIMIT_READ_AHEAD sets a lower depth.
+ * @param	state	embedDB algorithm state structure
+ * @param	pool	Buffer pool the pages are read into
+ * @return	Maximum number of pages to read ahead
+ */
+count_t readAheadDepth(embedDBState *state, embedDBBufferPool *pool) {
+    if (EMBEDDB_LIMITING_READ_AHEAD(state->parameters))
+        return min(state->readAheadDepth, pool->numFrames);
+    return pool->numFrames;
+}
+
+/**
+ * @brief	Submits reads for a range of data pages so they are in flight at the same time. Stops when no more reads can be submitted.
+ * @param	state		embedDB algorithm state structure
+ * @param	startPage	First logical data page to read
+ * @param	endPage		Logical data page after the last page to read
+ */
+void prefetchDataPages(embedDBState *state, id_t startPage, id_t endPage) {
+    if (state->fileInterface->submitRead == NULL)
+        return;
+
+    /* Never submit more pages than there are frames, or the first pages would be evicted before they are used */
+    endPage = min(endPage, startPage + readAheadDepth(state, &state->dataPool));
+    for (id_t pageId = startPage; pageId < endPage; pageId++) {
+        if (submitPageRead(state, state->dataFile, pageId % state->numDataPages) != 0)
+            return;
+    }
+}
+
+/**
+ * @brief	Reads a page from storage into the given buffer. The page is copied from the buffer pool if it holds it,
+ * 			otherwise it is read into the pool and then copied.
+ * 			If the page directly follows the last page read from this file and the file interface supports multi-page reads,
+ * 			the pages after it are read into the pool in the same call.
+ * @param	state		embedDB algorithm state structure
+ * @param	file		File to read from
+ * @param	buffer		Buffer to read the page into
+ * @param	pageNum		Physical page number to read
+ * @param	lastPageNum	Physical page number of the last page read from this file
+ * @param	numPages	Number of physical pages allocated to this file
+ * @return	Return the number of pages read from storage, -1 if error.
+ */
+int32_t readPageFromFile(embedDBState *state, void *file, void *buffer, id_t pageNum, id_t lastPageNum, uint32_t numPages) {
+    embedDBBufferPool *pool = bufferPoolForFile(state, file);
+    if (pool->numFrames == 0) {
+        if (0 == state->fileInterface->read(buffer, pageNum, state->pageSize, file))
+            return -1;
+        return 1;
+    }
+
+    embedDBFrame *frame = findFrame(pool, file, pageNum);
+    if (frame != NULL && completePageRead(state, pool, frame) == 0) {
+        pool->hits++;
+        if (frame->useCount < 2)
+            frame->useCount++;
+        memcpy(buffer, frameBuffer(state, pool, frame), state->pageSize);
+        return 0;
+    }
+    pool->misses++;
+
+    /* Read ahead up to the end of the file, never wrapping around to the start, and stop at pages the pool already holds */
+    uint32_t numToRead = 1;
+    if (state->fileInterface->readPages != NULL && pageNum == lastPageNum + 1 && pageNum + 1 < numPages) {
+        uint32_t maxToRead = min((uint32_t)readAheadDepth(state, pool) + 1, numPages - pageNum);
+        maxToRead = min(maxToRead, (uint32_t)pool->numFrames);
+        maxToRead = min(maxToRead, EMBEDDB_MAX_PAGES_PER_READ);
+        while (numToRead < maxToRead && findFrame(pool, file, pageNum + numToRead) == NULL) {
+            numToRead++;
+        }
+    }
+
+    /* Frames being filled are skipped by allocateFrame so each page gets its own frame */
+    void *buffers[EMBEDDB_MAX_PAGES_PER_READ];
+    embedDBFrame *frames[EMBEDDB_MAX_PAGES_PER_READ];
+    for (uint32_t i = 0; i < numToRead; i++) {
+        frames[i] = allocateFrame(state, pool);
+        assignFrame(pool, frames[i], file, pageNum + i, EMBEDDB_FRAME_FILLING);
+        buffers[i] = frameBuffer(state, pool, frames[i]);
+    }
+
+    if (numToRead > 1 && !state->fileInterface->readPages(buffers, pageNum, numToRead, state->pageSize, file)) {
+        /* Pages past the end of the file can not be read. Fall back to reading only the requested page */
+        for (uint32_t i = 1; i < numToRead; i++) {
+            releaseFrame(pool, frames[i]);
+        }
+        numToRead = 1;
+    }
+
+    if (numToRead == 1 && 0 == state->fileInterface->read(buffers[0], pageNum, state->pageSize, file)) {
+        releaseFrame(pool, frames[0]);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < numToRead; i++) {
+        frames[i]->status = EMBEDDB_FRAME_VALID;
+    }
+
+    /* Only the requested page has been used. Pages read ahead are reused first if they are never read */
+    frames[0]->useCount = 1;
+    memcpy(buffer, buffers[0], state->pageSize);
+    return numToRead;
+}
+
+/**
+ * @brief	Discards any buffered copies of pages in the given range of a file. Must be called before the pages are written or erased.
+ * @param	state		embedDB algorithm state structure
+ * @param	file		File the pages belong to
+ * @param	startPage	First physical page that is changing
+ * @param	endPage		Physical page after the last page that is changing
+ */
+void invalidateBufferedPages(embedDBState *state, void *file, id_t startPage, id_t endPage) {
+    embedDBBufferPool *pool = bufferPoolForFile(state, file);
+    for (count_t i = 0; i < pool->numFrames; i++) {
+        /* Look up each page of short ranges rather than checking every frame */
+        embedDBFrame *frame = NULL;
+        if (endPage - startPage < pool->numFrames) {
+            if (startPage + i >= endPage)
+                break;
+            frame = findFrame(pool, file, startPage + i);
+        } else if (pool->frames[i].file == file && pool->frames[i].pageId >= startPage && pool->frames[i].pageId < endPage) {
+            frame = &pool->frames[i];
+        }
+
+        if (frame != NULL) {
+            /* An outstanding read must finish before the page changes underneath it */
+            completePageRead(state, pool, frame);
+            releaseFrame(pool, frame);
+        }
+    }
+
+    id_t *bufferedPage = NULL;
+    if (file == state->dataFile) {
+        bufferedPage = &state->bufferedPageId;
+    } else if (file == state->indexFile) {
+        bufferedPage = &state->bufferedIndexPageId;
+    } else if (file == state->varFile) {
+        bufferedPage = &state->bufferedVarPage;
+    }
+
+    if (bufferedPage != NULL && *bufferedPage >= startPage && *bufferedPage < endPage) {
+        *bufferedPage = -1;
+    }
+}
+
 /**
  * @brief	Reads given page from storage.
  * @param	state	embedDB algorithm state structure
@@ -2262,10 +4922,13 @@ int8_t readPage(embedDBState *state, id_t pageNum) {
 
     /* Page is not in buffer. Read from storage. */
     /* Read page into start of buffer 1 */
-    if (0 == state->fileInterface->read(buf, pageNum, state->pageSize, state->dataFile))
+    int32_t pagesRead = readPageFromFile(state, state->dataFile, buf, pageNum, state->bufferedPageId, state->numDataPages);
+    if (pagesRead < 0)
         return -1;
 
-    state->numReads++;
+    if (pagesRead == 0)
+        state->bufferHits++;
+    state->numReads += pagesRead;
     state->bufferedPageId = pageNum;
     return 0;
 }
@@ -2287,10 +4950,13 @@ int8_t readIndexPage(embedDBState *state, id_t pageNum) {
 
     /* Page is not in buffer. Read from storage. */
     /* Read page into start of buffer */
-    if (0 == state->fileInterface->read(buf, pageNum, state->pageSize, state->indexFile))
+    int32_t pagesRead = readPageFromFile(state, state->indexFile, buf, pageNum, state->bufferedIndexPageId, state->numIndexPages);
+    if (pagesRead < 0)
         return -1;
 
-    state->numIdxReads++;
+    if (pagesRead == 0)
+        state->bufferHits++;
+    state->numIdxReads += pagesRead;
     state->bufferedIndexPageId = pageNum;
     return 0;
 }
@@ -2312,12 +4978,15 @@ int8_t readVariablePage(embedDBState *state, id_t pageNum) {
     void *buf = (int8_t *)state->buffer + EMBEDDB_VAR_READ_BUFFER(state->parameters) * state->pageSize;
 
     // Read in one page worth of data
-    if (state->fileInterface->read(buf, pageNum, state->pageSize, state->varFile) == 0) {
+    int32_t pagesRead = readPageFromFile(state, state->varFile, buf, pageNum, state->bufferedVarPage, state->numVarPages);
+    if (pagesRead < 0) {
         return -1;
     }
 
     // Track stats
-    state->numReads++;
+    if (pagesRead == 0)
+        state->bufferHits++;
+    state->numReads += pagesRead;
     state->bufferedVarPage = pageNum;
     return 0;
 }
@@ -2331,7 +5000,12 @@ void embedDBResetStats(embedDBState *state) {
     state->numWrites = 0;
     state->bufferHits = 0;
     state->numIdxReads = 0;
+    state->dataPool.hits = 0;
+    state->dataPool.misses = 0;
+    state->indexPool.hits = 0;
+    state->indexPool.misses = 0;
     state->numIdxWrites = 0;
+    state->maxSearchPageError = 0;
 }
 
 /**
@@ -2339,6 +5013,18 @@ void embedDBResetStats(embedDBState *state) {
  * @param	state	embedDB state structure
  */
 void embedDBClose(embedDBState *state) {
+    waitForSubmittedReads(state);
+    if (state->splineFile != NULL)
+        writeSplineCheckpoint(state);
+    if (state->summaryFile != NULL)
+        writeIndexSummaries(state);
+    if (state->superblockFile != NULL)
+        writeSuperblock(state);
+    closeBufferPool(&state->dataPool);
+    if (state->indexPool.pinned)
+        free(state->indexPool.pages);
+    closeBufferPool(&state->indexPool);
+
     if (state->dataFile != NULL) {
         state->fileInterface->close(state->dataFile);
     }
@@ -2348,9 +5034,35 @@ void embedDBClose(embedDBState *state) {
     if (state->varFile != NULL) {
         state->fileInterface->close(state->varFile);
     }
-    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+    if (state->splineFile != NULL) {
+        state->fileInterface->close(state->splineFile);
+    }
+    if (state->superblockFile != NULL) {
+        state->fileInterface->close(state->superblockFile);
+    }
+    if (EMBEDDB_USING_SPLINE(state->parameters)) {
         splineClose(state->spl);
         free(state->spl);
         state->spl = NULL;
     }
+    if (EMBEDDB_USING_FENCE_POINTERS(state->parameters)) {
+        free(state->fencePointers);
+        state->fencePointers = NULL;
+    }
+    if (state->bitmapFile != NULL) {
+        state->fileInterface->close(state->bitmapFile);
+    }
+    if (state->summaryFile != NULL) {
+        state->fileInterface->close(state->summaryFile);
+    }
+    if (EMBEDDB_USING_INDEX_SUMMARY(state->parameters)) {
+        free(state->indexSummaries);
+        state->indexSummaries = NULL;
+    }
+    if (EMBEDDB_USING_LEARNED_BITMAP(state->parameters)) {
+        free(state->bitmapBoundaries);
+        free(state->bitmapSample);
+        state->bitmapBoundaries = NULL;
+        state->bitmapSample = NULL;
+    }
 }
@@ -62,6 +62,17 @@ typedef uint16_t count_t;
 #define EMBEDDB_RECORD_LEVEL_CONSISTENCY 64
 #define EMBEDDB_USE_BINARY_SEARCH 128
 #define EMBEDDB_DISABLE_SPLINE_CLEAN 256
+#define EMBEDDB_PIN_INDEX 512
+#define EMBEDDB_LIMIT_READ_AHEAD 1024
+#define EMBEDDB_USE_PAGE_MODEL 2048
+#define EMBEDDB_PERSIST_SPLINE 4096
+#define EMBEDDB_USE_SUPERBLOCK 8192
+#define EMBEDDB_USE_FENCE_POINTERS 16384
+#define EMBEDDB_USE_BLOOM_FILTER 32768
+#define EMBEDDB_USE_ZONE_MAP 65536
+#define EMBEDDB_USE_LEARNED_BITMAP 131072
+#define EMBEDDB_USE_INDEX_SUMMARY 262144
+#define EMBEDDB_USE_RANGE_BITMAP 524288
 
 #define EMBEDDB_USING_INDEX(x) ((x & EMBEDDB_USE_INDEX) > 0 ? 1 : 0)
 #define EMBEDDB_USING_MAX_MIN(x) ((x & EMBEDDB_USE_MAX_MIN) > 0 ? 1 : 0)
@@ -71,6 +82,18 @@ typedef uint16_t count_t;
 #define EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(x) ((x & EMBEDDB_RECORD_LEVEL_CONSISTENCY) > 0 ? 1 : 0)
 #define EMBEDDB_USING_BINARY_SEARCH(x) ((x & EMBEDDB_USE_BINARY_SEARCH) > 0 ? 1 : 0)
 #define EMBEDDB_DISABLED_SPLINE_CLEAN(x) ((x & EMBEDDB_DISABLE_SPLINE_CLEAN) > 0 ? 1 : 0)
+#define EMBEDDB_PINNING_INDEX(x) ((x & EMBEDDB_PIN_INDEX) > 0 ? 1 : 0)
+#define EMBEDDB_LIMITING_READ_AHEAD(x) ((x & EMBEDDB_LIMIT_READ_AHEAD) > 0 ? 1 : 0)
+#define EMBEDDB_USING_PAGE_MODEL(x) ((x & EMBEDDB_USE_PAGE_MODEL) > 0 ? 1 : 0)
+#define EMBEDDB_PERSISTING_SPLINE(x) ((x & EMBEDDB_PERSIST_SPLINE) > 0 ? 1 : 0)
+#define EMBEDDB_USING_SUPERBLOCK(x) ((x & EMBEDDB_USE_SUPERBLOCK) > 0 ? 1 : 0)
+#define EMBEDDB_USING_FENCE_POINTERS(x) ((x & EMBEDDB_USE_FENCE_POINTERS) > 0 ? 1 : 0)
+#define EMBEDDB_USING_BLOOM_FILTER(x) ((x & EMBEDDB_USE_BLOOM_FILTER) > 0 ? 1 : 0)
+#define EMBEDDB_USING_ZONE_MAP(x) ((x & EMBEDDB_USE_ZONE_MAP) > 0 ? 1 : 0)
+#define EMBEDDB_USING_LEARNED_BITMAP(x) ((x & EMBEDDB_USE_LEARNED_BITMAP) > 0 ? 1 : 0)
+#define EMBEDDB_USING_INDEX_SUMMARY(x) ((x & EMBEDDB_USE_INDEX_SUMMARY) > 0 ? 1 : 0)
+#define EMBEDDB_USING_RANGE_BITMAP(x) ((x & EMBEDDB_USE_RANGE_BITMAP) > 0 ? 1 : 0)
+#define EMBEDDB_USING_SPLINE(x) ((x & (EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_USE_FENCE_POINTERS)) == 0 ? 1 : 0)
 #define EMBEDDB_RESETING_DATA(x) ((x & EMBEDDB_RESET_DATA) > 0 ? 1 : 0)
 
 /* Offsets with header */
@@ -80,8 +103,25 @@ typedef uint16_t count_t;
 #define EMBEDDB_MIN_OFFSET 14
 #define EMBEDDB_IDX_HEADER_SIZE 16
 
+/* Page model at the end of the data page header: float intercept, float slope and count_t max error */
+#define EMBEDDB_PAGE_MODEL_SIZE 10
+
 #define EMBEDDB_NO_VAR_DATA UINT32_MAX
 
+/* Define EMBEDDB_KEY_UINT32 or EMBEDDB_KEY_UINT64 to compare keys inline as that type instead of calling compareKey. keySize must match the type */
+#if defined(EMBEDDB_KEY_UINT32)
+#define EMBEDDB_KEY_TYPE uint32_t
+#elif defined(EMBEDDB_KEY_UINT64)
+#define EMBEDDB_KEY_TYPE uint64_t
+#endif
+
+/* Define EMBEDDB_DATA_INT32 or EMBEDDB_DATA_FLOAT to compare data inline as that type instead of calling compareData. The type is read from the start of the data, so dataSize must be at least its size */
+#if defined(EMBEDDB_DATA_INT32)
+#define EMBEDDB_DATA_TYPE int32_t
+#elif defined(EMBEDDB_DATA_FLOAT)
+#define EMBEDDB_DATA_TYPE float
+#endif
+
 #if !defined(ARDUINO) || defined(DIST)
 #define max(a, b) ((a) > (b) ? (a) : (b))
 #define min(a, b) ((a) < (b) ? (a) : (b))
@@ -98,12 +138,28 @@ typedef uint16_t count_t;
 #define EMBEDDB_GET_MIN_DATA(x, y) ((void *)((int8_t *)x + EMBEDDB_MIN_OFFSET + y->keySize * 2))
 #define EMBEDDB_GET_MAX_DATA(x, y) ((void *)((int8_t *)x + EMBEDDB_MIN_OFFSET + y->keySize * 2 + y->dataSize))
 
+#define EMBEDDB_GET_PAGE_MODEL(x, y) ((void *)((int8_t *)x + y->headerSize - EMBEDDB_PAGE_MODEL_SIZE))
+
 #define EMBEDDB_DATA_WRITE_BUFFER 0
 #define EMBEDDB_DATA_READ_BUFFER 1
 #define EMBEDDB_INDEX_WRITE_BUFFER 2
 #define EMBEDDB_INDEX_READ_BUFFER 3
 #define EMBEDDB_VAR_WRITE_BUFFER(x) ((x & EMBEDDB_USE_INDEX) ? 4 : 2)
 #define EMBEDDB_VAR_READ_BUFFER(x) ((x & EMBEDDB_USE_INDEX) ? 5 : 3)
+/* Buffer pages from this one onwards are not reserved and are used as frames of the buffer pool */
+#define EMBEDDB_FIRST_FRAME_BUFFER(x) (2 + ((x & EMBEDDB_USE_INDEX) ? 2 : 0) + ((x & EMBEDDB_USE_VDATA) ? 2 : 0))
+
+/* Status of a buffer frame */
+#define EMBEDDB_FRAME_EMPTY 0
+#define EMBEDDB_FRAME_READING 1
+#define EMBEDDB_FRAME_VALID 2
+#define EMBEDDB_FRAME_FILLING 3
+
+/* Marks the end of a chain of frames in the buffer pool hash table */
+#define EMBEDDB_NO_FRAME ((count_t)-1)
+
+/* Maximum number of pages requested in one call to readPages */
+#define EMBEDDB_MAX_PAGES_PER_READ 16
 
 #define EMBEDDB_FILE_MODE_W_PLUS_B 0  // Open file as read/write, creates file if doesn't exist, overwrites if it does. aka "w+b"
 #define EMBEDDB_FILE_MODE_R_PLUS_B 1  // Open file as read/write, file must exist, keeps data if it does. aka "r+b"
@@ -143,6 +199,7 @@ typedef uint16_t count_t;
 
 /**
  * @brief	An interface for embedDB to read/write to any storage medium at the page level of granularity
+ * 			Optional functions that are not supported must be NULL. Allocate the interface with calloc so they start as NULL
  */
 typedef struct {
     /**
@@ -193,12 +250,72 @@ typedef struct {
      * @return	1 for success and 0 for failure
      */
     int8_t (*flush)(void *file);
+
+    /**
+     * @brief	Optional. Reads numPages contiguous pages, starting at pageNum, in one call. Set to NULL if not supported
+     * @param	buffers		Array of numPages pre-allocated pages. Page pageNum + i is read into buffers[i]
+     * @param	pageNum		First page number to read. Is treated as an offset from the beginning of the file
+     * @param	numPages	Number of pages to read
+     * @param	pageSize	Number of bytes in a page
+     * @param	file		The file to read from. This is the file data that was stored in embedDBState->dataFile etc
+     * @return	1 for success and 0 for failure. Fails if any of the pages can not be read
+     */
+    int8_t (*readPages)(void **buffers, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file);
+
+    /**
+     * @brief	Optional. Starts reading a page into the buffer and returns without waiting for it. Set to NULL if not supported
+     * 			The buffer must not be used until waitRead has been called for it.
+     * @param	buffer		Pre-allocated space where data is read into
+     * @param	pageNum		Page number to read. Is treated as an offset from the beginning of the file
+     * @param	pageSize	Number of bytes in a page
+     * @param	file		The file to read from. This is the file data that was stored in embedDBState->dataFile etc
+     * @return	1 if the read was started and 0 if it was not. EmbedDB reads the page with read when it was not started
+     */
+    int8_t (*submitRead)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+
+    /**
+     * @brief	Optional. Waits until a read started by submitRead into the buffer has finished. Set to NULL if submitRead is NULL
+     * @param	buffer		The buffer that was given to submitRead
+     * @param	file		The file that was given to submitRead
+     * @return	1 if the whole page was read and 0 for failure
+     */
+    int8_t (*waitRead)(void *buffer, void *file);
 } embedDBFileInterface;
 
+/**
+ * @brief	A buffer pool page holding a page from storage
+ */
+typedef struct {
+    void *file;           /* File the page belongs to. NULL if the frame is empty */
+    id_t pageId;          /* Physical page id of the page in the frame */
+    uint8_t status;       /* EMBEDDB_FRAME_EMPTY, EMBEDDB_FRAME_READING if a read was submitted but not waited for, EMBEDDB_FRAME_FILLING while a synchronous read is in progress, or EMBEDDB_FRAME_VALID */
+    uint8_t useCount;     /* 0 if the page was read ahead and not used yet, 1 once it has been used, 2 once it has been used again. Lowered as the clock hand passes */
+    count_t nextInBucket; /* Next frame in the same hash bucket. EMBEDDB_NO_FRAME if this is the last one */
+} embedDBFrame;
+
+/**
+ * @brief	Pool of buffer pages caching pages read from storage. Frames are reused with the CLOCK policy
+ */
+typedef struct {
+    void *pages;          /* Buffer space of the pool. Frame i holds its page at pages + i * pageSize */
+    embedDBFrame *frames; /* Frame for each page. NULL if the pool is empty */
+    count_t *buckets;     /* Hash table of frames by page id. Each bucket is the first frame of a chain */
+    count_t numFrames;    /* Number of pages in the pool */
+    count_t clockHand;    /* Next frame the clock considers reusing */
+    id_t hits;            /* Number of page reads found in the pool */
+    id_t misses;          /* Number of page reads that went to storage */
+    uint8_t pinned;       /* 1 if the pool has a frame for every page of its file. Pages are never evicted and the pool owns its buffer space */
+} embedDBBufferPool;
+
 typedef struct {
     void *dataFile;                                                       /* File for storing data records. */
     void *indexFile;                                                      /* File for storing index records. */
     void *varFile;                                                        /* File for storing variable length data. */
+    void *splineFile;                                                     /* File for checkpointing the spline. Only used with EMBEDDB_PERSIST_SPLINE */
+    void *superblockFile;                                                 /* File for the superblock recording where each file starts and ends. Only used with EMBEDDB_USE_SUPERBLOCK */
+    void *bitmapFile;                                                     /* File the learned bitmap buckets are saved to. Only used with EMBEDDB_USE_LEARNED_BITMAP */
+    void *summaryFile;                                                    /* File the index page summaries are checkpointed to. Only used with EMBEDDB_USE_INDEX_SUMMARY */
+    uint32_t superblockSequence;                                          /* Sequence number of the last superblock written */
     embedDBFileInterface *fileInterface;                                  /* Interface to the file storage */
     uint32_t numDataPages;                                                /* The number of pages will use for storing fixed records*/
     uint32_t numIndexPages;                                               /* The number of pages will use for storing the data index */
@@ -219,10 +336,11 @@ typedef struct {
     void *buffer;                                                         /* Pre-allocated memory buffer for use by algorithm */
     spline *spl;                                                          /* Spline model */
     uint32_t numSplinePoints;                                             /* Number of spline points to allocate */
+    void *fencePointers;                                                  /* Smallest key of each data page, indexed by physical page id. Only used with EMBEDDB_USE_FENCE_POINTERS */
     int32_t indexMaxError;                                                /* Max error for indexing structure (Spline or PGM) */
-    int8_t bufferSizeInBlocks;                                            /* Size of buffer in blocks */
+    count_t bufferSizeInBlocks;                                           /* Size of buffer in blocks */
     count_t pageSize;                                                     /* Size of physical page on device */
-    int16_t parameters;                                                   /* Parameter flags for indexing and bitmaps */
+    uint32_t parameters;                                                  /* Parameter flags for indexing and bitmaps */
     int8_t keySize;                                                       /* Size of key in bytes (fixed-size records) */
     int8_t dataSize;                                                      /* Size of data in bytes (fixed-size records). Do not include space for variable size records if you are using them. */
     int8_t recordSize;                                                    /* Size of record in bytes (fixed-size records) */
@@ -231,12 +349,21 @@ typedef struct {
     int8_t bitmapSize;                                                    /* Size of bitmap in bytes */
     count_t maxRecordsPerPage;                                            /* Maximum records per page */
     count_t maxIdxRecordsPerPage;                                         /* Maximum index records per page */
+    count_t indexRecordSize;                                              /* Size of the index record for each data page: its bitmap, zone map and Bloom filter (calculated during init()) */
+    uint8_t bloomBitsPerKey;                                              /* Bloom filter bits for each record a data page can hold. Only used with EMBEDDB_USE_BLOOM_FILTER */
+    count_t bloomFilterSize;                                              /* Size of the Bloom filter of each data page in bytes (calculated during init()) */
     int8_t (*compareKey)(void *a, void *b);                               /* Function that compares two arbitrary keys passed as parameters */
     int8_t (*compareData)(void *a, void *b);                              /* Function that compares two arbitrary data values passed as parameters */
     void (*extractData)(void *data);                                      /* Given a record, function that extracts the data (key) value from that record */
     void (*buildBitmapFromRange)(void *minData, void *maxData, void *bm); /* Given a record, builds bitmap based on its data (key) value */
     void (*updateBitmap)(void *data, void *bm);                           /* Given a record, updates bitmap based on its data (key) value */
     int8_t (*inBitmap)(void *data, void *bm);                             /* Returns 1 if data (key) value is a valid value given the bitmap */
+    void *bitmapBoundaries;                                               /* Smallest data value of each bitmap bucket after the first. Only used with EMBEDDB_USE_LEARNED_BITMAP */
+    void *bitmapSample;                                                   /* Data values inserted so far, sampled to learn the bitmap buckets. NULL once they are learned */
+    uint32_t bitmapSampleSize;                                            /* Number of inserted data values to learn the bitmap buckets from. 0 to wait for embedDBLearnBitmap */
+    uint32_t numBitmapSamples;                                            /* Number of data values sampled so far */
+    uint8_t bitmapLearned;                                                /* 1 once the bitmap buckets are learned. Until then every page matches every query */
+    void *indexSummaries;                                                 /* First data page id and OR of the data page bitmaps of each index page, by physical index page. Only used with EMBEDDB_USE_INDEX_SUMMARY */
     uint64_t maxKey;                                                      /* Maximum key */
     int32_t maxError;                                                     /* Maximum key error */
     id_t numWrites;                                                       /* Number of page writes */
@@ -244,9 +371,13 @@ typedef struct {
     id_t numIdxWrites;                                                    /* Number of index page writes */
     id_t numIdxReads;                                                     /* Number of index page reads */
     id_t bufferHits;                                                      /* Number of pages returned from buffer rather than storage */
+    id_t maxSearchPageError;                                              /* Largest distance in pages between the page the spline predicted and the page a record was found on */
     id_t bufferedPageId;                                                  /* Page id currently in read buffer */
     id_t bufferedIndexPageId;                                             /* Index page id currently in index read buffer */
     id_t bufferedVarPage;                                                 /* Variable page id currently in variable read buffer */
+    embedDBBufferPool dataPool;                                           /* Pool caching pages read from storage in the spare buffer pages. Holds index pages only if indexPool is empty */
+    embedDBBufferPool indexPool;                                          /* Pool caching index pages. Uses part of the spare buffer pages, or holds the whole index file with EMBEDDB_PIN_INDEX */
+    count_t readAheadDepth;                                               /* Maximum number of pages read ahead of the page being read. Only used with EMBEDDB_LIMIT_READ_AHEAD, otherwise the whole buffer pool is used */
     uint8_t recordHasVarData;                                             /* Internal flag to signal that the record currently being written has var data */
 } embedDBState;
 
@@ -258,6 +389,9 @@ typedef struct {
     void *minData;
     void *maxData;
     void *queryBitmap;
+    uint32_t endDataPage;      /* Data page after the last page that can hold a key up to maxKey. Set by embedDBInitIterator */
+    uint32_t nextPrefetchPage; /* Next data page to consider reading ahead */
+    count_t numPrefetched;     /* Number of pages read ahead that the iterator has not reached yet */
 } embedDBIterator;
 
 typedef struct {
@@ -303,6 +437,17 @@ void embedDBPrintInit(embedDBState *state);
  */
 int8_t embedDBPut(embedDBState *state, void *key, void *data);
 
+/**
+ * @brief	Puts a batch of records, sorted by key, into structure. Keys must be strictly ascending and greater than every key already inserted.
+ * 			The whole batch is checked before any record is inserted, so a batch out of order inserts nothing.
+ * @param	state		embedDB algorithm state structure
+ * @param	keys		Keys for the records, stored contiguously (numRecords * keySize bytes)
+ * @param	data		Data for the records, stored contiguously (numRecords * dataSize bytes)
+ * @param	numRecords	Number of records in the batch
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBPutBatch(embedDBState *state, void *keys, void *data, uint32_t numRecords);
+
 /**
  * @brief	Puts the given key, data, and variable length data into the structure.
  * @param	state			embedDB algorithm state structure
@@ -396,6 +541,34 @@ int8_t embedDBFlush(embedDBState *state);
  */
 int8_t embedDBFlushVar(embedDBState *state);
 
+/**
+ * @brief	Does work that would otherwise stall the next insert. If a file is full, its oldest block is erased now instead of by the next page written to it.
+ * 			Call it when the application is idle, such as between sensor samples, to keep insert latency flat once the files have wrapped.
+ * @param	state	algorithm state structure
+ * @returns 0 if successul and a non-zero value otherwise
+ */
+int8_t embedDBMaintenance(embedDBState *state);
+
+/**
+ * @brief	Learns equi-depth bitmap buckets from a sample of data values and saves them to the bitmap file.
+ * 			Only used with EMBEDDB_USE_LEARNED_BITMAP, in place of sampling the first bitmapSampleSize values inserted.
+ * 			Pages written before the buckets are learned match every query.
+ * @param	state		embedDB algorithm state structure
+ * @param	sample		Data values to learn from, stored contiguously (numValues * dataSize bytes). Not changed
+ * @param	numValues	Number of values in the sample
+ * @return	Return 0 if success. Non-zero value if error or the buckets are already learned.
+ */
+int8_t embedDBLearnBitmap(embedDBState *state, void *sample, uint32_t numValues);
+
+/**
+ * @brief	Checks if a data value is in a bitmap, using the learned buckets with EMBEDDB_USE_LEARNED_BITMAP and inBitmap otherwise.
+ * @param	state	embedDB algorithm state structure
+ * @param	data	Data value to check
+ * @param	bm		Bitmap to check
+ * @return	Non-zero if the value's bucket is set in the bitmap, 0 if not.
+ */
+int8_t embedDBInBitmap(embedDBState *state, void *data, void *bm);
+
 /**
  * @brief	Reads given page from storage.
  * @param	state	embedDB algorithm state structure
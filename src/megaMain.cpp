@@ -53,8 +53,8 @@ static ArduinoOutStream cout(Serial);
 #include "serial_c_iface.h"
 
 /**
- * 0 - 2 are for benchmarks
- * 3 is for the example program
+ * 0 is for the example program
+ * 1 - 5 are for benchmarks
  *
  */
 #ifndef WHICH_PROGRAM
@@ -69,6 +69,10 @@ static ArduinoOutStream cout(Serial);
 #include "benchmarks/variableDataBenchmark.h"
 #elif WHICH_PROGRAM == 3
 #include "benchmarks/queryInterfaceBenchmark.h"
+#elif WHICH_PROGRAM == 4
+#include "benchmarks/recoveryBenchmark.h"
+#elif WHICH_PROGRAM == 5
+#include "benchmarks/rangeBitmapBenchmark.h"
 #endif
 
 #define ENABLE_DEDICATED_SPI 1
@@ -109,6 +113,10 @@ void setup() {
     test_vardata();
 #elif WHICH_PROGRAM == 3
     advancedQueryExample();
+#elif WHICH_PROGRAM == 4
+    runRecoveryBenchmark();
+#elif WHICH_PROGRAM == 5
+    runRangeBitmapBenchmark();
 #endif
 }
 
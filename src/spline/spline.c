@@ -66,6 +66,84 @@ void splineInit(spline *spl, id_t size, size_t maxError, uint8_t keySize) {
     spl->upper = malloc(pointSize);
     spl->firstSplinePoint = malloc(pointSize);
     spl->numAddCalls = 0;
+    spl->numErased = 0;
+    spl->radixTable = NULL;
+    spl->radixFilled = 0;
+    spl->radixBits = 0;
+}
+
+/**
+ * @brief	Fills the radix table entries up to the prefix of a key with the number of the point holding it.
+ */
+static void splineRadixFill(spline *spl, uint64_t keyVal, size_t pointIndex) {
+    uint64_t prefix = (keyVal - spl->radixBaseKey) >> spl->radixShift;
+    for (; spl->radixFilled <= prefix; spl->radixFilled++) {
+        spl->radixTable[spl->radixFilled] = spl->numErased + pointIndex;
+    }
+}
+
+/**
+ * @brief	Rebuilds the radix table from the current points. Prefixes are taken relative to the first point and the
+ * 			shift leaves half the table free for later points.
+ * @param	spl	Spline structure
+ */
+void splineRadixRebuild(spline *spl) {
+    if (spl->radixTable == NULL)
+        return;
+    spl->radixFilled = 0;
+    spl->radixShift = 0;
+    if (spl->count == 0)
+        return;
+
+    uint64_t lastKeyVal = 0;
+    spl->radixBaseKey = 0;
+    memcpy(&spl->radixBaseKey, splinePointLocation(spl, 0), spl->keySize);
+    memcpy(&lastKeyVal, splinePointLocation(spl, spl->count - 1), spl->keySize);
+    while (((lastKeyVal - spl->radixBaseKey) >> spl->radixShift) >= ((uint64_t)1 << (spl->radixBits - 1)))
+        spl->radixShift++;
+
+    for (size_t i = 0; i < spl->count; i++) {
+        uint64_t keyVal = 0;
+        memcpy(&keyVal, splinePointLocation(spl, i), spl->keySize);
+        splineRadixFill(spl, keyVal, i);
+    }
+}
+
+/**
+ * @brief	Adds the last spline point to the radix table, rebuilding the table if its prefix does not fit.
+ */
+static void splineRadixAdd(spline *spl) {
+    if (spl->radixTable == NULL)
+        return;
+
+    uint64_t keyVal = 0;
+    memcpy(&keyVal, splinePointLocation(spl, spl->count - 1), spl->keySize);
+    if (spl->radixFilled == 0) {
+        spl->radixBaseKey = keyVal;
+        spl->radixShift = 0;
+    }
+    if (((keyVal - spl->radixBaseKey) >> spl->radixShift) >= ((uint64_t)1 << spl->radixBits)) {
+        splineRadixRebuild(spl);
+        return;
+    }
+    splineRadixFill(spl, keyVal, spl->count - 1);
+}
+
+/**
+ * @brief	Adds a radix table over the spline points so splineFind only searches the points sharing a key prefix.
+ * @param	spl			Spline structure
+ * @param	radixBits	Number of key prefix bits to index, from 2 to 20. The table uses 4 * 2^radixBits bytes
+ * @return	Returns zero if successful and one if not
+ */
+int splineInitRadix(spline *spl, uint8_t radixBits) {
+    if (radixBits < 2 || radixBits > 20)
+        return 1;
+    spl->radixTable = (id_t *)malloc(sizeof(id_t) * ((size_t)1 << radixBits));
+    if (spl->radixTable == NULL)
+        return 1;
+    spl->radixBits = radixBits;
+    splineRadixRebuild(spl);
+    return 0;
 }
 
 /**
@@ -100,6 +178,7 @@ void splineAdd(spline *spl, void *key, uint32_t page) {
         memcpy(spl->firstSplinePoint, key, spl->keySize);
         memcpy(((int8_t *)spl->firstSplinePoint + spl->keySize), &page, sizeof(uint32_t));
         spl->count++;
+        splineRadixAdd(spl);
         memcpy(spl->lastKey, key, spl->keySize);
         return;
     }
@@ -163,6 +242,7 @@ void splineAdd(spline *spl, void *key, uint32_t page) {
         memcpy(nextSplinePoint, spl->lastKey, spl->keySize);
         memcpy((int8_t *)nextSplinePoint + spl->keySize, &spl->lastLoc, sizeof(uint32_t));
         spl->count++;
+        splineRadixAdd(spl);
         spl->tempLastPoint = 0;
 
         /* Update upper and lower limits. */
@@ -205,6 +285,7 @@ void splineAdd(spline *spl, void *key, uint32_t page) {
     memcpy(tempSplinePoint, spl->lastKey, spl->keySize);
     memcpy((int8_t *)tempSplinePoint + spl->keySize, &spl->lastLoc, sizeof(uint32_t));
     spl->count++;
+    splineRadixAdd(spl);
 
     spl->tempLastPoint = 1;
 }
@@ -224,8 +305,13 @@ int splineErase(spline *spl, uint32_t numPoints) {
 
     spl->count -= numPoints;
     spl->pointsStartIndex = (spl->pointsStartIndex + numPoints) % spl->size;
-    if (spl->count == 0)
+    /* Radix table entries count erased points, so they stay valid as the start index moves */
+    spl->numErased += numPoints;
+    if (spl->count == 0) {
         spl->numAddCalls = 0;
+        spl->numErased = 0;
+        spl->radixFilled = 0;
+    }
     return 0;
 }
 
@@ -354,7 +440,18 @@ void splineFind(spline *spl, void *key, int8_t compareKey(void *, void *), id_t
         return;
     } else {
         // Perform a binary seach to find the spline point above the key we're looking for
-        pointIdx = pointsBinarySearch(spl, 0, spl->count - 1, key, compareKey);
+        int first = 0, last = spl->count - 1;
+        if (spl->radixTable != NULL && spl->radixFilled > 0) {
+            // Only the points from the first with the key's prefix to the first with the next prefix can be above the key
+            uint64_t prefix = (keyVal - spl->radixBaseKey) >> spl->radixShift;
+            if (prefix >= spl->radixFilled)
+                prefix = spl->radixFilled - 1;
+            if (spl->radixTable[prefix] > spl->numErased)
+                first = spl->radixTable[prefix] - spl->numErased;
+            if (prefix + 1 < spl->radixFilled && spl->radixTable[prefix + 1] - spl->numErased < (size_t)last)
+                last = spl->radixTable[prefix + 1] - spl->numErased;
+        }
+        pointIdx = pointsBinarySearch(spl, first, last, key, compareKey);
     }
 
     // Interpolate between two spline points
@@ -393,6 +490,7 @@ void splineClose(spline *spl) {
     free(spl->lower);
     free(spl->upper);
     free(spl->firstSplinePoint);
+    free(spl->radixTable);
 }
 
 /**
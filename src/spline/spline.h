@@ -62,6 +62,12 @@ struct spline_s {
     uint32_t numAddCalls;    /* Number of times the add method has been called */
     uint32_t tempLastPoint;  /* Last spline point is temporary if value is not 0 */
     uint8_t keySize;         /* Size of key in bytes */
+    size_t numErased;        /* Number of points erased since the spline was empty */
+    id_t *radixTable;        /* Radix table. Entry i is the number of the first point whose key prefix is at least i, counting erased points. NULL if not used */
+    uint32_t radixFilled;    /* Number of radix table entries in use */
+    uint64_t radixBaseKey;   /* Key that prefixes are taken relative to */
+    uint8_t radixBits;       /* Number of key prefix bits indexed by the radix table */
+    uint8_t radixShift;      /* Number of bits a key offset is shifted right to get its prefix */
 };
 
 /**
@@ -73,6 +79,20 @@ struct spline_s {
  */
 void splineInit(spline *spl, id_t size, size_t maxError, uint8_t keySize);
 
+/**
+ * @brief	Adds a radix table over the spline points so splineFind only searches the points sharing a key prefix.
+ * @param	spl			Spline structure
+ * @param	radixBits	Number of key prefix bits to index, from 2 to 20. The table uses 4 * 2^radixBits bytes
+ * @return	Returns zero if successful and one if not
+ */
+int splineInitRadix(spline *spl, uint8_t radixBits);
+
+/**
+ * @brief	Rebuilds the radix table from the current points. Call after the points are replaced directly, such as when loading them.
+ * @param	spl	Spline structure
+ */
+void splineRadixRebuild(spline *spl);
+
 /**
  * @brief	Builds a spline structure given a sorted data set. GreedySplineCorridor
  * implementation from "Smooth interpolating histograms with error guarantees"
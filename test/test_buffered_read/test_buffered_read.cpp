@@ -71,12 +71,12 @@
 #include "unity.h"
 
 int insertStaticRecord(embedDBState* state, uint32_t key, uint32_t data);
-embedDBState* init_state();
+embedDBState* init_state(count_t bufferSizeInBlocks);
 
 embedDBState* state;
 
 void setUp(void) {
-    state = init_state();
+    state = init_state(4);
 }
 
 void tearDown(void) {
@@ -262,6 +262,37 @@ void embedDBGet_should_return_no_data_found_when_database_and_buffer_are_empty(v
     TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, status, "embedDBGet returned data when there were no keys in the database or write buffer");
 }
 
+void embedDBGet_should_return_repeated_lookups_from_buffer_pool(void) {
+    /* Leave eight buffer pages for the buffer pool */
+    tearDown();
+    state = init_state(12);
+
+    for (uint32_t i = 0; i < 3000; ++i) {
+        insertStaticRecord(state, i, (i + 100));
+    }
+    embedDBFlush(state);
+
+    /* Alternate between pages far apart so a single read buffer would read a page on every lookup */
+    uint32_t hotKeys[] = {10, 1500, 2900};
+    uint32_t actualData[] = {0, 0, 0};
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &hotKeys[i], actualData), "embedDBGet was unable to find a record.");
+    }
+
+    embedDBResetStats(state);
+    for (int round = 0; round < 5; round++) {
+        for (int i = 0; i < 3; i++) {
+            int8_t getResult = embedDBGet(state, &hotKeys[i], actualData);
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, getResult, "embedDBGet was unable to find a record.");
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(hotKeys[i] + 100, actualData[0], "embedDBGet did not return the correct data.");
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numReads, "embedDBGet read pages from storage that were already in the buffer pool.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->dataPool.misses, "Buffer pool recorded misses for pages it held.");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, state->dataPool.hits, "Buffer pool did not record any hits.");
+}
+
 int runUnityTests() {
     UNITY_BEGIN();
     RUN_TEST(embedDBGet_should_return_data_when_single_record_inserted_and_flushed_to_storage);
@@ -273,6 +304,7 @@ int runUnityTests() {
     RUN_TEST(embedDBGet_should_return_not_found_when_key_is_less_then_min_key);
     RUN_TEST(embedDBGet_should_return_no_data_found_when_database_and_buffer_are_empty);
     RUN_TEST(embedDBGet_should_return_not_found_when_key_is_less_then_min_key_and_in_buffer);
+    RUN_TEST(embedDBGet_should_return_repeated_lookups_from_buffer_pool);
     return UNITY_END();
 }
 
@@ -290,7 +322,7 @@ int insertStaticRecord(embedDBState* state, uint32_t key, uint32_t data) {
     return (result == 0) ? 0 : -1;
 }
 
-embedDBState* init_state() {
+embedDBState* init_state(count_t bufferSizeInBlocks) {
     embedDBState* state = (embedDBState*)malloc(sizeof(embedDBState));
     if (state == NULL) {
         printf("Unable to allocate state. Exiting\n");
@@ -303,7 +335,7 @@ embedDBState* init_state() {
     state->pageSize = 512;
     state->numSplinePoints = 20;
     state->bitmapSize = 1;
-    state->bufferSizeInBlocks = 4;
+    state->bufferSizeInBlocks = bufferSizeInBlocks;
 
     // allocate buffer
     state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
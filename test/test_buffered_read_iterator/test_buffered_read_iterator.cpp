@@ -71,12 +71,12 @@
 
 int insertStaticRecord(embedDBState* state, uint32_t key, uint32_t data);
 int8_t insertRecordFloatData(embedDBState* state, uint32_t key, float data);
-embedDBState* init_state();
+embedDBState* init_state(uint32_t parameters, uint32_t numDataPages);
 
 embedDBState* state;
 
 void setUp(void) {
-    state = init_state();
+    state = init_state(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_RESET_DATA, 256);
 }
 
 void tearDown(void) {
@@ -310,6 +310,209 @@ void embedDBIterator_should_not_flush_buffer_to_storage_to_iterate(void) {
     embedDBCloseIterator(&it);
 }
 
+void embedDBIterator_should_not_read_index_pages_when_index_is_pinned(void) {
+    /* Enough data pages that the index needs more than one page */
+    tearDown();
+    state = init_state(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_PIN_INDEX | EMBEDDB_RESET_DATA, 1024);
+    uint32_t numberOfRecordsToInsert = 20000;
+    for (uint32_t i = 0; i < numberOfRecordsToInsert; ++i) {
+        insertStaticRecord(state, i, i % 100);
+    }
+    embedDBFlush(state);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(1, state->nextIdxPageId, "The test needs more than one index page.");
+
+    /* Each scan reads the index pages in order, so a single index read buffer would read them all again */
+    embedDBResetStats(state);
+    uint32_t minData = 10, maxData = 12;
+    for (int scan = 0; scan < 2; scan++) {
+        embedDBIterator it;
+        uint32_t itKey = 0;
+        uint32_t itData[] = {0, 0, 0};
+        it.minKey = NULL;
+        it.maxKey = NULL;
+        it.minData = &minData;
+        it.maxData = &maxData;
+        embedDBInitIterator(state, &it);
+
+        uint32_t numberOfRecordsRetrieved = 0;
+        while (embedDBNext(state, &it, &itKey, itData)) {
+            if (itData[0] >= minData && itData[0] <= maxData)
+                numberOfRecordsRetrieved++;
+        }
+        embedDBCloseIterator(&it);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(600, numberOfRecordsRetrieved, "embedDBIterator did not return the expected number of records");
+    }
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numIdxReads, "embedDBIterator read index pages from storage while the index was pinned in memory.");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, state->indexPool.hits, "Index buffer pool did not record any hits.");
+}
+
+void embedDBIterator_should_skip_pages_outside_data_range_with_zone_maps(void) {
+    /* No bitmap, so only the zone maps in the index can rule out pages */
+    tearDown();
+    state = init_state(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_INDEX | EMBEDDB_USE_ZONE_MAP | EMBEDDB_RESET_DATA, 1024);
+
+    /* Data rises slowly like a sensor reading, so each page covers a narrow range. The flush leaves a partial index page part way through */
+    uint32_t numberOfRecordsToInsert = 2000;
+    for (uint32_t i = 0; i < numberOfRecordsToInsert; ++i) {
+        insertStaticRecord(state, i, i / 20);
+        if (i == 1000)
+            embedDBFlush(state);
+    }
+
+    embedDBResetStats(state);
+    embedDBIterator it;
+    uint32_t itKey = 0;
+    uint32_t itData[] = {0, 0, 0};
+    uint32_t minData = 80, maxData = 81;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBInitIterator(state, &it);
+
+    uint32_t expectedKeyValue = 1600;
+    while (embedDBNext(state, &it, &itKey, itData)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedKeyValue, itKey, "embedDBIterator returned the wrong record with zone maps.");
+        expectedKeyValue++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1640, expectedKeyValue, "embedDBIterator did not return every record in the data range with zone maps.");
+
+    /* The 40 matching records span at most 3 of the 69 data pages */
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->minIndexPageId, "The test needs every data page in the index.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(3, state->numReads, "embedDBIterator read pages the zone maps ruled out.");
+}
+
+void embedDBIterator_should_jump_to_matching_pages_across_index_pages(void) {
+    tearDown();
+    state = init_state(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_RESET_DATA, 1024);
+
+    /* Only every 50th page holds data in the lowest bitmap bucket. The pages span two index pages */
+    uint32_t numberOfPages = 600;
+    for (uint32_t i = 0; i < numberOfPages * state->maxRecordsPerPage; ++i) {
+        uint32_t page = i / state->maxRecordsPerPage;
+        insertStaticRecord(state, i, page % 50 == 7 ? 5 : 150);
+    }
+
+    embedDBResetStats(state);
+    embedDBIterator it;
+    uint32_t itKey = 0;
+    uint32_t itData[] = {0, 0, 0};
+    uint32_t minData = 0, maxData = 9;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBInitIterator(state, &it);
+
+    uint32_t numRecords = 0;
+    while (embedDBNext(state, &it, &itKey, itData)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(7, itKey / state->maxRecordsPerPage % 50, "embedDBIterator returned a record from a page that does not match.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, itData[0], "embedDBIterator returned the wrong data.");
+        numRecords++;
+    }
+    embedDBCloseIterator(&it);
+
+    /* The last page is still in the write buffer, so 12 matching pages are read from storage */
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(12 * state->maxRecordsPerPage, numRecords, "embedDBIterator did not return every matching record.");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(state->maxIdxRecordsPerPage, state->nextDataPageId, "The test needs data pages on more than one index page.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(12, state->numReads, "embedDBIterator read data pages the bitmap index ruled out.");
+}
+
+/* Returns the number of records with data from minData to maxData and checks that at most maxReads data pages are read to find them */
+uint32_t countRangeBitmapQuery(uint32_t* minData, uint32_t* maxData, uint32_t maxReads) {
+    embedDBResetStats(state);
+    embedDBIterator it;
+    uint32_t itKey = 0;
+    uint32_t itData[] = {0, 0, 0};
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = minData;
+    it.maxData = maxData;
+    embedDBInitIterator(state, &it);
+
+    uint32_t numRecords = 0;
+    while (embedDBNext(state, &it, &itKey, itData)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(300 + itKey / 40, itData[0], "embedDBIterator returned the wrong data with range-encoded bitmaps.");
+        numRecords++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(maxReads, state->numReads, "Range-encoded bitmaps did not rule out the pages outside the data range.");
+    return numRecords;
+}
+
+void embedDBIterator_should_skip_pages_with_range_encoded_bitmaps(void) {
+    tearDown();
+    state = init_state(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_RANGE_BITMAP | EMBEDDB_RESET_DATA, 1024);
+
+    /* Data rises slowly from 300 to 799 like a temperature reading */
+    for (uint32_t i = 0; i < 20000; ++i) {
+        insertStaticRecord(state, i, 300 + i / 40);
+    }
+
+    /* Only a min: pages are read if they have data above 680, the last threshold below the min */
+    uint32_t minData = 700;
+    uint32_t firstPage = (681 - 300) * 40 / state->maxRecordsPerPage;
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(100 * 40, countRangeBitmapQuery(&minData, NULL, state->nextDataPageId - firstPage), "embedDBIterator did not return every record above the min with range-encoded bitmaps.");
+
+    /* A min and max take one probe each: pages need data above 380 and at or below 500 */
+    minData = 400;
+    uint32_t maxData = 450;
+    firstPage = (381 - 300) * 40 / state->maxRecordsPerPage;
+    uint32_t lastPage = (501 - 300) * 40 / state->maxRecordsPerPage;
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(51 * 40, countRangeBitmapQuery(&minData, &maxData, lastPage - firstPage + 1), "embedDBIterator did not return every record in the data range with range-encoded bitmaps.");
+}
+
+void buildBitmapInt16RangeFromRange_should_set_one_threshold_for_each_bound(void) {
+    /* The thresholds are 320 to 740 in steps of 60 */
+    int32_t min = 400, max = 450;
+    uint16_t bm = 0;
+    buildBitmapInt16RangeFromRange(&min, NULL, &bm);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(0x0040, bm, "A min should only set the last threshold below it, 380, in the low byte.");
+    buildBitmapInt16RangeFromRange(NULL, &max, &bm);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(0x1000, bm, "A max should only set the first threshold at or above it, 500, in the high byte.");
+    buildBitmapInt16RangeFromRange(&min, &max, &bm);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(0x1040, bm, "A min and max should set one threshold in each byte.");
+
+    /* Bounds past the thresholds rule nothing out, or only the pages entirely beyond the last threshold */
+    min = 100;
+    max = 1000;
+    buildBitmapInt16RangeFromRange(&min, &max, &bm);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(0, bm, "Bounds outside every threshold should set no bits, so every page matches.");
+    buildBitmapInt16RangeFromRange(&max, NULL, &bm);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(0x0001, bm, "A min above every threshold should set the last threshold, 740.");
+    buildBitmapInt16RangeFromRange(NULL, &min, &bm);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(0x8000, bm, "A max below every threshold should set the first threshold, 320.");
+    int32_t below = 300, above = 330;
+    TEST_ASSERT_TRUE_MESSAGE(inBitmapInt16Range(&below, &bm), "A value at or below the first threshold should match a max below every threshold.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, inBitmapInt16Range(&above, &bm), "A value above the first threshold should not match a max below every threshold.");
+}
+
+void buildBitmapInt32RangeFromRange_should_set_one_threshold_for_each_bound(void) {
+    /* The thresholds are 320 to 770 in steps of 30 */
+    int32_t min = 400, max = 450;
+    uint32_t bm = 0;
+    buildBitmapInt32RangeFromRange(&min, NULL, &bm);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0x00002000, bm, "A min should only set the last threshold below it, 380, in the low half.");
+    buildBitmapInt32RangeFromRange(NULL, &max, &bm);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0x04000000, bm, "A max should only set the first threshold at or above it, 470, in the high half.");
+    buildBitmapInt32RangeFromRange(&min, &max, &bm);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0x04002000, bm, "A min and max should set one threshold in each half.");
+
+    min = 100;
+    max = 1000;
+    buildBitmapInt32RangeFromRange(&min, &max, &bm);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, bm, "Bounds outside every threshold should set no bits, so every page matches.");
+    buildBitmapInt32RangeFromRange(&max, NULL, &bm);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0x00000001, bm, "A min above every threshold should set the last threshold, 770.");
+    buildBitmapInt32RangeFromRange(NULL, &min, &bm);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0x80000000, bm, "A max below every threshold should set the first threshold, 320.");
+    int32_t below = 300, above = 330;
+    TEST_ASSERT_TRUE_MESSAGE(inBitmapInt32Range(&below, &bm), "A value at or below the first threshold should match a max below every threshold.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, inBitmapInt32Range(&above, &bm), "A value above the first threshold should not match a max below every threshold.");
+}
+
 int runUnityTests() {
     UNITY_BEGIN();
     RUN_TEST(embedDBIterator_should_return_records_in_storage_and_in_write_buffer);
@@ -317,6 +520,12 @@ int runUnityTests() {
     RUN_TEST(embedDBIterator_should_return_keys_in_write_buffer_when_no_data_has_been_flushed_to_storage);
     RUN_TEST(embedDBIterator_should_filter_and_rechieve_records_by_data_value);
     RUN_TEST(embedDBIterator_should_not_flush_buffer_to_storage_to_iterate);
+    RUN_TEST(embedDBIterator_should_not_read_index_pages_when_index_is_pinned);
+    RUN_TEST(embedDBIterator_should_skip_pages_outside_data_range_with_zone_maps);
+    RUN_TEST(embedDBIterator_should_jump_to_matching_pages_across_index_pages);
+    RUN_TEST(embedDBIterator_should_skip_pages_with_range_encoded_bitmaps);
+    RUN_TEST(buildBitmapInt16RangeFromRange_should_set_one_threshold_for_each_bound);
+    RUN_TEST(buildBitmapInt32RangeFromRange_should_set_one_threshold_for_each_bound);
     return UNITY_END();
 }
 
@@ -351,7 +560,7 @@ int8_t insertRecordFloatData(embedDBState* state, uint32_t key, float data) {
     return (result == 0) ? 0 : -1;
 }
 
-embedDBState* init_state() {
+embedDBState* init_state(uint32_t parameters, uint32_t numDataPages) {
     embedDBState* state = (embedDBState*)malloc(sizeof(embedDBState));
     if (state == NULL) {
         printf("Unable to allocate state. Exiting\n");
@@ -376,7 +585,7 @@ embedDBState* init_state() {
     }
 
     // address level parameters
-    state->numDataPages = 256;
+    state->numDataPages = numDataPages;
     state->numIndexPages = 8;
     state->eraseSizeInPages = 4;
 
@@ -387,12 +596,19 @@ embedDBState* init_state() {
     state->indexFile = setupFile(indexPath);
 
     // configure state
-    state->parameters = EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_RESET_DATA;
+    state->parameters = parameters;
 
     // Setup for data and bitmap comparison functions */
-    state->inBitmap = inBitmapInt8;
-    state->updateBitmap = updateBitmapInt8;
-    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    if (EMBEDDB_USING_RANGE_BITMAP(parameters)) {
+        state->bitmapSize = 2;
+        state->inBitmap = inBitmapInt16Range;
+        state->updateBitmap = updateBitmapInt16Range;
+        state->buildBitmapFromRange = buildBitmapInt16RangeFromRange;
+    } else {
+        state->inBitmap = inBitmapInt8;
+        state->updateBitmap = updateBitmapInt8;
+        state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    }
     state->compareKey = int32Comparator;
     state->compareData = int32Comparator;
 
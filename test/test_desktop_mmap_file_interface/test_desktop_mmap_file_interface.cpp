@@ -0,0 +1,210 @@
+/******************************************************************************/
+/**
+ * @file        test_desktop_mmap_file_interface.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test for the memory-mapped desktop file interface.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getMmapFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_FILE_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#endif
+
+#include "unity.h"
+
+#define UNITY_SUPPORT_64
+
+embedDBState *state;
+
+void initializeEmbedDB(int16_t parameters) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 8;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->fileInterface = getMmapFileInterface();
+    state->dataFile = setupFile(DATA_FILE_PATH);
+    state->numDataPages = 92;
+    state->eraseSizeInPages = 4;
+    state->parameters = parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int64Comparator;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void setUp() {
+    initializeEmbedDB(EMBEDDB_RESET_DATA);
+}
+
+void tearDown() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void insertRecords(int32_t startingKey, int64_t startingData, int32_t numRecords) {
+    int32_t key = startingKey;
+    int64_t data = startingData;
+    for (int i = 0; i < numRecords; i++) {
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDBPut did not correctly insert data (returned non-zero code)");
+        key++;
+        data++;
+    }
+}
+
+void mmap_interface_reads_back_written_pages() {
+    embedDBFileInterface *fileInterface = state->fileInterface;
+    void *file = state->dataFile;
+    uint8_t *page = (uint8_t *)malloc(state->pageSize);
+    uint8_t *readPage = (uint8_t *)malloc(state->pageSize);
+
+    /* Write pages out of order so the file has to grow past pages that were never written */
+    uint32_t pageNums[] = {5, 0, 3};
+    for (int i = 0; i < 3; i++) {
+        memset(page, pageNums[i] + 1, state->pageSize);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(1, fileInterface->write(page, pageNums[i], state->pageSize, file), "Memory-mapped write failed.");
+    }
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, fileInterface->flush(file), "Memory-mapped flush failed.");
+
+    for (int i = 0; i < 3; i++) {
+        memset(page, pageNums[i] + 1, state->pageSize);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(1, fileInterface->read(readPage, pageNums[i], state->pageSize, file), "Memory-mapped read failed.");
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(page, readPage, state->pageSize, "Memory-mapped read did not return the page that was written.");
+    }
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, fileInterface->read(readPage, 6, state->pageSize, file), "Memory-mapped read past the end of the file should fail.");
+    free(page);
+    free(readPage);
+}
+
+void mmap_interface_gets_and_iterates_records() {
+    insertRecords(100, 5000, 1500);
+    embedDBFlush(state);
+
+    int64_t data = 0;
+    for (int32_t key = 100; key < 1600; key++) {
+        int8_t result = embedDBGet(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBGet did not find a record inserted through the memory-mapped interface.");
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(key + 4900, data, "embedDBGet returned the wrong data through the memory-mapped interface.");
+    }
+
+    embedDBIterator it;
+    uint32_t minKey = 500, maxKey = 900;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+
+    int32_t key = 0;
+    int32_t count = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(500 + count, key, "embedDBNext returned keys out of order through the memory-mapped interface.");
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(401, count, "embedDBNext did not return every record in range through the memory-mapped interface.");
+}
+
+void mmap_interface_recovers_records_after_reload() {
+    insertRecords(1000, 5600, 3655);
+    embedDBFlush(state);
+    tearDown();
+    initializeEmbedDB(0);
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(88, state->nextDataPageId, "EmbedDB nextDataPageId is not correctly identified after reload through the memory-mapped interface.");
+
+    int64_t data = 0;
+    for (int32_t key = 1000; key < 4654; key++) {
+        int8_t result = embedDBGet(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBGet did not find a record after reload through the memory-mapped interface.");
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(key + 4600, data, "embedDBGet returned the wrong data after reload through the memory-mapped interface.");
+    }
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(mmap_interface_reads_back_written_pages);
+    RUN_TEST(mmap_interface_gets_and_iterates_records);
+    RUN_TEST(mmap_interface_recovers_records_after_reload);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -61,42 +61,59 @@
 #define setupFile setupSDFile
 #define tearDownFile tearDownSDFile
 #define DATA_PATH "dataFile.bin"
+#define BITMAP_PATH "bitmapFile.bin"
+#define SUMMARY_PATH "summaryFile.bin"
 #else
 #include "desktopFileInterface.h"
 #define DATA_PATH "build/artifacts/dataFile.bin"
+#define BITMAP_PATH "build/artifacts/bitmapFile.bin"
+#define SUMMARY_PATH "build/artifacts/summaryFile.bin"
 #endif
 
 #include "unity.h"
 
 embedDBState *state;
 
-void setupEmbedDB() {
+/* Allocates a state and returns the result of embedDBInit */
+int8_t initializeEmbedDB(uint32_t parameters, size_t indexMaxError, count_t bufferSizeInBlocks) {
     state = (embedDBState *)malloc(sizeof(embedDBState));
     TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBstate.");
     state->keySize = 4;
     state->dataSize = 4;
     state->pageSize = 512;
-    state->bufferSizeInBlocks = 2;
+    state->bufferSizeInBlocks = bufferSizeInBlocks;
     state->numSplinePoints = 8;
     state->buffer = malloc(state->bufferSizeInBlocks * state->pageSize);
     TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
     state->numDataPages = 1000;
-    state->parameters = EMBEDDB_RESET_DATA;
+    state->parameters = parameters;
     state->eraseSizeInPages = 4;
+    state->bitmapSize = 1;
 
     /* setup data file for EmbedDB */
     state->fileInterface = getFileInterface();
     char dataPath[] = DATA_PATH;
     state->dataFile = setupFile(dataPath);
 
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
     state->compareKey = int32Comparator;
     state->compareData = int32Comparator;
-    int8_t result = embedDBInit(state, 1);
+    return embedDBInit(state, indexMaxError);
+}
+
+void setupEmbedDBWithMaxError(uint32_t parameters, size_t indexMaxError) {
+    int8_t result = initializeEmbedDB(parameters, indexMaxError, 2);
     TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
 }
 
+void setupEmbedDB(uint32_t parameters) {
+    setupEmbedDBWithMaxError(parameters, 1);
+}
+
 void setUp(void) {
-    setupEmbedDB();
+    setupEmbedDB(EMBEDDB_RESET_DATA);
 }
 
 void tearDown(void) {
@@ -239,6 +256,315 @@ void embedDBFlush_does_not_write_when_nothing_in_buffer() {
     TEST_ASSERT_EQUAL_UINT32_MESSAGE(1000, state->numAvailDataPages, "embedDBFlush should not change numAvailDataPages when no records in buffer.");
 }
 
+void embedDBMaintenance_erases_next_block_before_put_needs_it() {
+    /* Fill the data file so the next page written would have to erase a block */
+    uint32_t key = 0;
+    while (state->numAvailDataPages > 0) {
+        int32_t data = key % 100;
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data (returned non-zero code)");
+        key++;
+    }
+
+    int8_t result = embedDBMaintenance(state);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBMaintenance did not erase the next block.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->minDataPageId, "embedDBMaintenance did not free the oldest block.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->numAvailDataPages, "embedDBMaintenance did not make the erased block available.");
+
+    /* A second call has nothing to do until the file is full again */
+    result = embedDBMaintenance(state);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBMaintenance failed when there was nothing to erase.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->minDataPageId, "embedDBMaintenance erased a block when the file was not full.");
+
+    /* Writing the next page should use the erased block instead of erasing another */
+    for (int32_t i = 0; i < 63; i++) {
+        int32_t data = key % 100;
+        result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data (returned non-zero code)");
+        key++;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->minDataPageId, "embedDBPut erased a block after embedDBMaintenance already had.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, state->numAvailDataPages, "embedDBPut did not write into the erased block.");
+
+    int32_t data = 0;
+    uint32_t oldestKey = 4 * 63;
+    result = embedDBGet(state, &oldestKey, &data);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBGet did not find the oldest record left after embedDBMaintenance.");
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(oldestKey % 100, data, "embedDBGet returned the wrong data after embedDBMaintenance.");
+}
+
+void embedDBPutBatch_writes_same_pages_as_embedDBPut() {
+    int16_t parameters = EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_BMAP | EMBEDDB_RESET_DATA;
+    const uint32_t numRecords = 1000;
+    uint32_t *keys = (uint32_t *)malloc(numRecords * sizeof(uint32_t));
+    int32_t *data = (int32_t *)malloc(numRecords * sizeof(int32_t));
+    for (uint32_t i = 0; i < numRecords; i++) {
+        keys[i] = i * 3 + 7;
+        data[i] = (int32_t)((i * 7919) % 1000) - 500;
+    }
+
+    tearDown();
+    setupEmbedDB(parameters);
+    for (uint32_t i = 0; i < numRecords; i++) {
+        int8_t result = embedDBPut(state, &keys[i], &data[i]);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data (returned non-zero code)");
+    }
+    embedDBFlush(state);
+    uint32_t numPages = state->nextDataPageId;
+    int8_t *expectedPages = (int8_t *)malloc((size_t)numPages * state->pageSize);
+    for (uint32_t i = 0; i < numPages; i++) {
+        readPage(state, i);
+        memcpy(expectedPages + (size_t)i * state->pageSize, (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize, state->pageSize);
+    }
+
+    /* Batches of different sizes start and end part way through pages */
+    tearDown();
+    setupEmbedDB(parameters);
+    uint32_t batchSizes[] = {100, 1, 299, 600};
+    uint32_t inserted = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        int8_t result = embedDBPutBatch(state, &keys[inserted], &data[inserted], batchSizes[i]);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPutBatch did not correctly insert data (returned non-zero code)");
+        inserted += batchSizes[i];
+    }
+    embedDBFlush(state);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numPages, state->nextDataPageId, "embedDBPutBatch wrote a different number of pages than embedDBPut.");
+    for (uint32_t i = 0; i < numPages; i++) {
+        readPage(state, i);
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expectedPages + (size_t)i * state->pageSize, (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize, state->pageSize, "embedDBPutBatch wrote a different page than embedDBPut.");
+    }
+
+    free(expectedPages);
+    free(keys);
+    free(data);
+}
+
+void embedDBPutBatch_rejects_keys_out_of_order_without_inserting() {
+    uint32_t keys[] = {10, 11, 12, 14, 13};
+    int32_t data[] = {1, 2, 3, 4, 5};
+    int8_t result = embedDBPutBatch(state, keys, data, 3);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPutBatch did not correctly insert data (returned non-zero code)");
+
+    result = embedDBPutBatch(state, &keys[3], &data[3], 2);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, result, "embedDBPutBatch accepted a batch with keys out of order.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, EMBEDDB_GET_COUNT(state->buffer), "embedDBPutBatch inserted part of a batch with keys out of order.");
+
+    result = embedDBPutBatch(state, &keys[2], &data[2], 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, result, "embedDBPutBatch accepted a key that was already inserted.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, EMBEDDB_GET_COUNT(state->buffer), "embedDBPutBatch inserted a key that was already inserted.");
+}
+
+void embedDBGet_finds_records_with_page_model() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_USE_PAGE_MODEL | EMBEDDB_RESET_DATA);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(16, state->headerSize, "EmbedDB headerSize did not include the page model.");
+
+    /* Keys with uneven gaps so the page models have a non-zero error */
+    uint32_t key = 100;
+    for (int32_t i = 0; i < 2000; i++) {
+        key += i % 7 == 0 ? 50 : 1 + i % 3;
+        int8_t result = embedDBPut(state, &key, &i);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data (returned non-zero code)");
+    }
+    embedDBFlush(state);
+
+    key = 100;
+    int32_t data = 0;
+    for (int32_t i = 0; i < 2000; i++) {
+        uint32_t missingKey = key + 1;
+        key += i % 7 == 0 ? 50 : 1 + i % 3;
+        int8_t result = embedDBGet(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBGet did not find a record on a page with a model.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(i, data, "embedDBGet returned the wrong data on a page with a model.");
+        if (missingKey < key) {
+            result = embedDBGet(state, &missingKey, &data);
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, result, "embedDBGet found a key that was not inserted on a page with a model.");
+        }
+    }
+}
+
+void embedDBGet_reads_log_pages_of_spline_error() {
+    tearDown();
+    setupEmbedDBWithMaxError(EMBEDDB_RESET_DATA, 32);
+
+    /* Keys that grow quadratically so the spline predictions are off by many pages */
+    for (uint32_t i = 0; i < 30000; i++) {
+        uint32_t key = i + i * i / 64;
+        int8_t result = embedDBPut(state, &key, &i);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data (returned non-zero code)");
+    }
+    embedDBFlush(state);
+    embedDBResetStats(state);
+
+    id_t maxReads = 0;
+    int32_t data = 0;
+    for (uint32_t i = 0; i < 30000; i += 7) {
+        uint32_t key = i + i * i / 64;
+        id_t numReads = state->numReads;
+        int8_t result = embedDBGet(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBGet did not find a record the spline predicted the wrong page for.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(i, data, "embedDBGet returned the wrong data for a record the spline predicted the wrong page for.");
+        if (state->numReads - numReads > maxReads)
+            maxReads = state->numReads - numReads;
+    }
+
+    /* Galloping reads at most two pages for each doubling of the distance from the predicted page */
+    uint32_t errorBits = 0;
+    while ((state->maxSearchPageError >> errorBits) > 0)
+        errorBits++;
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, state->maxSearchPageError, "The spline predicted every page exactly, so the search was not tested.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(2 * errorBits + 2, maxReads, "embedDBGet read more pages than a galloping search needs.");
+}
+
+/* Keys that are not evenly spaced, so finding a page cannot rely on a linear model */
+uint32_t fencePointerTestKey(uint32_t i) {
+    return i * 3 + (i / 100) * (i / 100);
+}
+
+void embedDBGet_reads_one_page_with_fence_pointers() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_FENCE_POINTERS);
+
+    /* Wrap the data file so the oldest pages are erased and page ids no longer match physical pages */
+    uint32_t numRecords = 1500 * state->maxRecordsPerPage;
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = fencePointerTestKey(i);
+        int8_t result = embedDBPut(state, &key, &i);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data (returned non-zero code)");
+    }
+    embedDBFlush(state);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, state->minDataPageId, "The data file did not wrap, so erased pages were not tested.");
+    embedDBResetStats(state);
+
+    int32_t data = 0;
+    uint32_t firstRecord = state->minDataPageId * state->maxRecordsPerPage;
+    for (uint32_t i = firstRecord; i < numRecords; i += 13) {
+        uint32_t key = fencePointerTestKey(i);
+        id_t numReads = state->numReads + state->bufferHits;
+        int8_t result = embedDBGet(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBGet did not find a record with fence pointers.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(i, data, "embedDBGet returned the wrong data with fence pointers.");
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(1, state->numReads + state->bufferHits - numReads, "embedDBGet read more than one page with fence pointers.");
+
+        /* Keys between records are on no page */
+        key++;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was never inserted.");
+    }
+
+    uint32_t erasedKey = fencePointerTestKey(firstRecord - 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &erasedKey, &data), "embedDBGet found a record on an erased page.");
+
+    /* Iterators start on the page the min key is on */
+    uint32_t minRecord = firstRecord + 5000, maxRecord = firstRecord + 5100;
+    uint32_t minKey = fencePointerTestKey(minRecord), maxKey = fencePointerTestKey(maxRecord);
+    embedDBIterator it;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(minRecord / state->maxRecordsPerPage, it.nextDataPage, "The iterator did not start on the page holding the min key.");
+    uint32_t key = 0, record = minRecord;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(record, data, "The iterator returned the wrong record with fence pointers.");
+        record++;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(maxRecord + 1, record, "The iterator did not return every record in the key range.");
+    embedDBCloseIterator(&it);
+}
+
+void embedDBSearchNode_matches_brute_force_search_for_every_page_fill() {
+    int32_t data = 0;
+    uint32_t key = 0;
+    for (uint32_t fill = 1; fill <= state->maxRecordsPerPage; fill++) {
+        tearDown();
+        setupEmbedDB(EMBEDDB_RESET_DATA);
+
+        /* Even keys from 10, so every odd key and the keys past either end are missing */
+        for (int32_t i = 0; i < (int32_t)fill; i++) {
+            key = 10 + 2 * i;
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &i), "embedDBPut did not correctly insert data (returned non-zero code)");
+        }
+        embedDBFlush(state);
+
+        for (uint32_t target = 8; target <= 12 + 2 * fill; target++) {
+            int8_t present = target >= 10 && target < 10 + 2 * fill && target % 2 == 0;
+            int8_t result = embedDBGet(state, &target, &data);
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(present ? 0 : -1, result, "embedDBGet disagreed with a brute-force search of the page.");
+            if (present)
+                TEST_ASSERT_EQUAL_INT32_MESSAGE((target - 10) / 2, data, "embedDBGet returned the wrong record of the page.");
+
+            /* An iterator starts at the first record with a key at least the min key */
+            int32_t expected = target <= 10 ? 0 : (target - 9) / 2;
+            embedDBIterator it;
+            it.minKey = &target;
+            it.maxKey = NULL;
+            it.minData = NULL;
+            it.maxData = NULL;
+            embedDBInitIterator(state, &it);
+            if (expected < (int32_t)fill) {
+                TEST_ASSERT_TRUE_MESSAGE(embedDBNext(state, &it, &key, &data), "The iterator returned no record when the page had a larger key.");
+                TEST_ASSERT_EQUAL_INT32_MESSAGE(expected, data, "The iterator did not start at the first record with a key at least the min key.");
+            } else {
+                TEST_ASSERT_FALSE_MESSAGE(embedDBNext(state, &it, &key, &data), "The iterator returned a record with a key below the min key.");
+            }
+            embedDBCloseIterator(&it);
+        }
+    }
+}
+
+void embedDBInit_frees_what_it_allocated_when_it_fails() {
+    tearDown();
+
+    /* Bloom filters without an index are rejected after the buffer pools and spline are allocated */
+    int8_t result = initializeEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_BLOOM_FILTER, 1, 8);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, result, "embedDBInit accepted Bloom filters without an index.");
+    TEST_ASSERT_NULL_MESSAGE(state->dataPool.frames, "embedDBInit did not free the data buffer pool when it failed.");
+    TEST_ASSERT_NULL_MESSAGE(state->spl, "embedDBInit did not free the spline when it failed.");
+
+    /* A pinned index pool is allocated before an index with Bloom filters of no bits is rejected */
+    state->parameters = EMBEDDB_RESET_DATA | EMBEDDB_USE_INDEX | EMBEDDB_PIN_INDEX | EMBEDDB_USE_BLOOM_FILTER;
+    state->numIndexPages = 4;
+    state->bloomBitsPerKey = 0;
+    result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, result, "embedDBInit accepted Bloom filters with no bits per key.");
+    TEST_ASSERT_NULL_MESSAGE(state->indexPool.frames, "embedDBInit did not free the index buffer pool when it failed.");
+    TEST_ASSERT_NULL_MESSAGE(state->indexPool.pages, "embedDBInit did not free the pinned index pages when it failed.");
+
+    /* The fence pointers take the place of the spline */
+    state->parameters = EMBEDDB_RESET_DATA | EMBEDDB_USE_FENCE_POINTERS | EMBEDDB_USE_BLOOM_FILTER;
+    result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, result, "embedDBInit accepted Bloom filters without an index.");
+    TEST_ASSERT_NULL_MESSAGE(state->fencePointers, "embedDBInit did not free the fence pointers when it failed.");
+
+    /* The learned bitmap buckets and their sample are allocated before the index is checked */
+    state->parameters = EMBEDDB_RESET_DATA | EMBEDDB_USE_BMAP | EMBEDDB_USE_LEARNED_BITMAP | EMBEDDB_USE_BLOOM_FILTER;
+    state->bitmapSampleSize = 16;
+    char bitmapPath[] = BITMAP_PATH;
+    state->bitmapFile = setupFile(bitmapPath);
+    result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, result, "embedDBInit accepted Bloom filters without an index.");
+    TEST_ASSERT_NULL_MESSAGE(state->bitmapBoundaries, "embedDBInit did not free the learned bitmap buckets when it failed.");
+    TEST_ASSERT_NULL_MESSAGE(state->bitmapSample, "embedDBInit did not free the bitmap sample when it failed.");
+    tearDownFile(state->bitmapFile);
+
+    /* The index page summaries are allocated before the index is initialized */
+    state->parameters = EMBEDDB_RESET_DATA | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX_SUMMARY | EMBEDDB_USE_BLOOM_FILTER;
+    char summaryPath[] = SUMMARY_PATH;
+    state->summaryFile = setupFile(summaryPath);
+    result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, result, "embedDBInit accepted Bloom filters with no bits per key.");
+    TEST_ASSERT_NULL_MESSAGE(state->indexSummaries, "embedDBInit did not free the index page summaries when it failed.");
+    tearDownFile(state->summaryFile);
+
+    /* embedDBClose is only for states that initialized */
+    free(state->buffer);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+    setupEmbedDB(EMBEDDB_RESET_DATA);
+}
+
 int runUnityTests(void) {
     UNITY_BEGIN();
     RUN_TEST(embedDB_initial_configuration_is_correct);
@@ -248,6 +574,14 @@ int runUnityTests(void) {
     RUN_TEST(embedDB_put_inserts_one_more_than_one_page_of_records_correctly);
     RUN_TEST(iteratorReturnsCorrectRecords);
     RUN_TEST(embedDBFlush_does_not_write_when_nothing_in_buffer);
+    RUN_TEST(embedDBMaintenance_erases_next_block_before_put_needs_it);
+    RUN_TEST(embedDBPutBatch_writes_same_pages_as_embedDBPut);
+    RUN_TEST(embedDBPutBatch_rejects_keys_out_of_order_without_inserting);
+    RUN_TEST(embedDBGet_finds_records_with_page_model);
+    RUN_TEST(embedDBGet_reads_log_pages_of_spline_error);
+    RUN_TEST(embedDBGet_reads_one_page_with_fence_pointers);
+    RUN_TEST(embedDBSearchNode_matches_brute_force_search_for_every_page_fill);
+    RUN_TEST(embedDBInit_frees_what_it_allocated_when_it_fails);
     return UNITY_END();
 }
 
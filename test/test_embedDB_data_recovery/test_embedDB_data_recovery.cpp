@@ -58,9 +58,13 @@
 #define setupFile setupSDFile
 #define tearDownFile tearDownSDFile
 #define DATA_FILE_PATH "dataFile.bin"
+#define SPLINE_FILE_PATH "splineFile.bin"
+#define SUPERBLOCK_FILE_PATH "superblockFile.bin"
 #else
 #include "desktopFileInterface.h"
 #define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define SPLINE_FILE_PATH "build/artifacts/splineFile.bin"
+#define SUPERBLOCK_FILE_PATH "build/artifacts/superblockFile.bin"
 /* On the desktop platform, there is a file interface which simulates "erasing" by writing out all 1's to the location in the file ot be erased */
 #define MOCK_ERASE_INTERFACE
 #endif
@@ -70,17 +74,19 @@
 #define UNITY_SUPPORT_64
 
 embedDBState *state;
+void *splineFile, *superblockFile;
 
-void setupEmbedDB() {
+/* Allocates a state on the data file. Set any other fields, then call initializeEmbedDB */
+void allocateEmbedDB(uint32_t parameters) {
     state = (embedDBState *)malloc(sizeof(embedDBState));
-    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate EmbedDB state.");
+    /* Fill the state with garbage so fields embedDBInit reads before setting them make the tests fail */
+    memset(state, 0xA5, sizeof(embedDBState));
     state->keySize = 4;
     state->dataSize = 8;
     state->pageSize = 512;
     state->bufferSizeInBlocks = 4;
     state->numSplinePoints = 8;
-    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
-    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
 
 /* configure EmbedDB storage */
 #ifdef MOCK_ERASE_INTERFACE
@@ -92,39 +98,42 @@ void setupEmbedDB() {
 
     state->numDataPages = 92;
     state->eraseSizeInPages = 4;
-    state->parameters = EMBEDDB_RESET_DATA;
+    state->parameters = parameters;
     state->compareKey = int32Comparator;
     state->compareData = int64Comparator;
-    int8_t result = embedDBInit(state, 1);
-    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
 }
 
-void initalizeEmbedDBFromFile(void) {
-    state = (embedDBState *)malloc(sizeof(embedDBState));
-    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate EmbedDB state.");
-    state->keySize = 4;
-    state->dataSize = 8;
-    state->pageSize = 512;
-    state->bufferSizeInBlocks = 4;
-    state->numSplinePoints = 8;
+/* Allocates the buffer for the state from allocateEmbedDB and initializes EmbedDB */
+void initializeEmbedDB(const char *message) {
     state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
     TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, message);
+}
 
-/* configure EmbedDB storage */
-#ifdef MOCK_ERASE_INTERFACE
-    state->fileInterface = getMockEraseFileInterface();
-#else
-    state->fileInterface = getFileInterface();
-#endif
-    state->dataFile = setupFile(DATA_FILE_PATH);
+void setupEmbedDB() {
+    allocateEmbedDB(EMBEDDB_RESET_DATA);
+    initializeEmbedDB("EmbedDB did not initialize correctly.");
+}
 
-    state->numDataPages = 92;
-    state->eraseSizeInPages = 4;
-    state->parameters = 0;
-    state->compareKey = int32Comparator;
-    state->compareData = int64Comparator;
-    int8_t result = embedDBInit(state, 1);
-    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+void initalizeEmbedDBFromFile(void) {
+    allocateEmbedDB(0);
+    initializeEmbedDB("EmbedDB did not initialize correctly.");
+}
+
+void initializeEmbedDBWithCheckpointFiles(uint32_t parameters) {
+    allocateEmbedDB(parameters);
+    splineFile = setupFile(SPLINE_FILE_PATH);
+    superblockFile = setupFile(SUPERBLOCK_FILE_PATH);
+    state->splineFile = splineFile;
+    state->superblockFile = superblockFile;
+    initializeEmbedDB("EmbedDB did not initialize correctly with checkpoint files.");
+}
+
+void tearDownWithCheckpointFiles() {
+    tearDown();
+    tearDownFile(splineFile);
+    tearDownFile(superblockFile);
 }
 
 void setUp() {
@@ -338,6 +347,242 @@ void embedDB_recovery_algorithm_functions_correctly_when_have_wrapped_but_at_the
     TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&expectedData, &actualData, sizeof(int64_t), "embedDBGet did not return the correct data for a key inserted after recovery.");
 }
 
+void embedDB_returns_pages_written_after_they_were_read_ahead() {
+    insertRecordsLinearly(0, 0, 7728);
+    embedDBFlush(state);
+    tearDown();
+    initalizeEmbedDBFromFile();
+
+    /* Scan the first pages so the pages after them are held in the read-ahead buffers */
+    embedDBIterator it;
+    uint32_t minKey = 3865, maxKey = 3949;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    int32_t key = 0;
+    int64_t data = 0;
+    uint32_t count = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(85, count, "embedDBNext did not return the records in the first pages.");
+
+    /* Overwrite the physical pages that were just read */
+    insertRecordsLinearly(10000, 10000, 168);
+    embedDBFlush(state);
+
+    /* Query the newest pages first so they are not simply read again in order */
+    char message[100];
+    for (key = 10168; key > 10000; key--) {
+        int8_t result = embedDBGet(state, &key, &data);
+        snprintf(message, 100, "embedDBGet did not find key %li after its page was overwritten.", key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, message);
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(key, data, "embedDBGet returned data from a page that was overwritten.");
+    }
+
+    /* Full scan must return every record exactly once and in order */
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    embedDBInitIterator(state, &it);
+    int32_t previousKey = 0;
+    count = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(key, data, "embedDBNext returned data from a page that was overwritten.");
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(previousKey + 1, key, "embedDBNext returned keys out of order.");
+        previousKey = key;
+        count++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3864, count, "embedDBNext did not return every record after the read-ahead pages were overwritten.");
+
+    /* Sequential scans are served from the read-ahead buffers when the file interface can read multiple pages at once */
+    if (state->fileInterface->readPages != NULL) {
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(1, state->bufferHits, "Sequential scans did not use the read-ahead buffers.");
+    }
+}
+
+void embedDB_recovery_finds_last_page_for_every_position_of_the_write_head() {
+    /* Covers the last page of the file, block boundaries and pages inside a block, before and after wrapping */
+    uint32_t numPages[] = {1, 2, 4, 5, 46, 47, 91, 92, 93, 95, 96, 97, 130, 183, 184};
+    int64_t data = 0;
+    for (uint32_t i = 0; i < sizeof(numPages) / sizeof(numPages[0]); i++) {
+        if (i > 0) {
+            tearDown();
+            setupEmbedDB();
+        }
+        int32_t numRecords = numPages[i] * state->maxRecordsPerPage;
+        insertRecordsLinearly(0, 0, numRecords);
+        embedDBFlush(state);
+        tearDown();
+        initalizeEmbedDBFromFile();
+
+        char message[100];
+        snprintf(message, 100, "EmbedDB nextDataPageId is not correctly identified after reload with %lu pages written.", (unsigned long)numPages[i]);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(numPages[i], state->nextDataPageId, message);
+        int32_t key = numRecords;
+        snprintf(message, 100, "embedDBGet did not find the last record after reload with %lu pages written.", (unsigned long)numPages[i]);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(numRecords, data, "embedDBGet returned the wrong data for the last record after reload.");
+    }
+}
+
+void embedDB_loads_spline_checkpoint_and_adds_pages_written_after_it() {
+    tearDown();
+    initializeEmbedDBWithCheckpointFiles(EMBEDDB_RESET_DATA | EMBEDDB_PERSIST_SPLINE);
+    insertRecordsParabolic(1000, 0, 1260);
+    embedDBFlush(state);
+
+    /* Pages written after the checkpoint are lost from it when the spline file is not written on close */
+    insertRecordsLinearly(800000, 0, 1260);
+    state->parameters &= ~EMBEDDB_PERSIST_SPLINE;
+    tearDownWithCheckpointFiles();
+
+    /* Rebuild the spline from every page to compare against */
+    initalizeEmbedDBFromFile();
+    uint32_t pointSize = state->keySize + sizeof(uint32_t);
+    uint32_t expectedCount = state->spl->count;
+    uint32_t expectedStart = state->spl->pointsStartIndex;
+    int8_t *expectedPoints = (int8_t *)malloc(state->spl->size * pointSize);
+    memcpy(expectedPoints, state->spl->points, state->spl->size * pointSize);
+    id_t expectedNextPageId = state->nextDataPageId;
+    tearDown();
+
+    initializeEmbedDBWithCheckpointFiles(EMBEDDB_PERSIST_SPLINE);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNextPageId, state->nextDataPageId, "EmbedDB nextDataPageId is not correctly identified when loading the spline checkpoint.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedCount, state->spl->count, "Spline loaded from the checkpoint does not have the same number of points as a rebuilt spline.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedStart, state->spl->pointsStartIndex, "Spline loaded from the checkpoint does not start at the same point as a rebuilt spline.");
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expectedPoints, state->spl->points, state->spl->size * pointSize, "Spline loaded from the checkpoint does not match a rebuilt spline.");
+    free(expectedPoints);
+
+    int32_t key = 1000;
+    int64_t expectedData = 1, data = 0;
+    char message[100];
+    for (int32_t i = 0; i < 1260; i++) {
+        key += i;
+        int8_t result = embedDBGet(state, &key, &data);
+        snprintf(message, 100, "embedDBGet did not find key %li after loading the spline checkpoint.", key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, message);
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(expectedData, data, "embedDBGet returned the wrong data after loading the spline checkpoint.");
+        expectedData++;
+    }
+    key = 801000;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record written after the spline checkpoint.");
+    TEST_ASSERT_EQUAL_INT64_MESSAGE(1000, data, "embedDBGet returned the wrong data for a record written after the spline checkpoint.");
+    tearDownWithCheckpointFiles();
+    setupEmbedDB();
+}
+
+void embedDB_ignores_spline_checkpoint_from_a_different_data_file() {
+    tearDown();
+    initializeEmbedDBWithCheckpointFiles(EMBEDDB_RESET_DATA | EMBEDDB_PERSIST_SPLINE);
+    insertRecordsLinearly(0, 0, 2100);
+    embedDBFlush(state);
+    tearDownWithCheckpointFiles();
+
+    /* Replace the data file without updating the spline file */
+    setupEmbedDB();
+    insertRecordsLinearly(500000, 0, 2100);
+    embedDBFlush(state);
+    tearDown();
+
+    initializeEmbedDBWithCheckpointFiles(EMBEDDB_PERSIST_SPLINE);
+    int64_t data = 0;
+    for (int32_t key = 500001; key <= 502100; key++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record after a stale spline checkpoint.");
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(key - 500000, data, "embedDBGet returned the wrong data after a stale spline checkpoint.");
+    }
+    int32_t key = 1000;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet returned a record from the replaced data file.");
+    tearDownWithCheckpointFiles();
+    setupEmbedDB();
+}
+
+void embedDB_recovers_from_superblock_and_pages_written_after_it() {
+    tearDown();
+    initializeEmbedDBWithCheckpointFiles(EMBEDDB_RESET_DATA | EMBEDDB_USE_SUPERBLOCK);
+    insertRecordsLinearly(0, 0, 30 * state->maxRecordsPerPage);
+    embedDBFlush(state);
+
+    /* Wrap the file after the superblock is written, then close without writing it again. The last full page is still in the write buffer */
+    insertRecordsLinearly(30 * state->maxRecordsPerPage, 30 * state->maxRecordsPerPage, 70 * state->maxRecordsPerPage);
+    state->parameters &= ~EMBEDDB_USE_SUPERBLOCK;
+    tearDownWithCheckpointFiles();
+
+    /* Scan the data file to compare against */
+    initalizeEmbedDBFromFile();
+    id_t expectedNextDataPageId = state->nextDataPageId;
+    id_t expectedMinDataPageId = state->minDataPageId;
+    uint32_t expectedNumAvailDataPages = state->numAvailDataPages;
+    tearDown();
+
+    initializeEmbedDBWithCheckpointFiles(EMBEDDB_USE_SUPERBLOCK);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(99, state->nextDataPageId, "EmbedDB nextDataPageId is not correctly identified from the superblock.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNextDataPageId, state->nextDataPageId, "EmbedDB nextDataPageId from the superblock does not match scanning the data file.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedMinDataPageId, state->minDataPageId, "EmbedDB minDataPageId from the superblock does not match scanning the data file.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNumAvailDataPages, state->numAvailDataPages, "EmbedDB numAvailDataPages from the superblock does not match scanning the data file.");
+
+    int64_t data = 0;
+    for (int32_t key = state->minDataPageId * state->maxRecordsPerPage + 1; key <= 99 * state->maxRecordsPerPage; key++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record after recovering from the superblock.");
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(key, data, "embedDBGet returned the wrong data after recovering from the superblock.");
+    }
+
+    /* Records written after recovery go after the last page */
+    insertRecordsLinearly(100 * state->maxRecordsPerPage, 100 * state->maxRecordsPerPage, state->maxRecordsPerPage);
+    embedDBFlush(state);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(100, state->nextDataPageId, "EmbedDB did not write after the last page found from the superblock.");
+    tearDownWithCheckpointFiles();
+    setupEmbedDB();
+}
+
+void embedDB_rebuilds_fence_pointers_after_reload_with_wrapped_data() {
+    insertRecordsLinearly(0, 0, 13758);
+    embedDBFlush(state);
+    tearDown();
+    initializeEmbedDBWithCheckpointFiles(EMBEDDB_USE_FENCE_POINTERS);
+
+    int64_t data = 0;
+    for (int32_t key = state->minDataPageId * state->maxRecordsPerPage + 1; key <= 13758; key++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record with fence pointers after reloading.");
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(key, data, "embedDBGet returned the wrong data with fence pointers after reloading.");
+    }
+    int32_t key = state->minDataPageId * state->maxRecordsPerPage;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a record on a page erased before reloading.");
+    tearDownWithCheckpointFiles();
+    setupEmbedDB();
+}
+
+void embedDB_uses_older_superblock_when_newest_is_damaged() {
+    tearDown();
+    initializeEmbedDBWithCheckpointFiles(EMBEDDB_RESET_DATA | EMBEDDB_USE_SUPERBLOCK);
+    insertRecordsLinearly(0, 0, 10 * state->maxRecordsPerPage);
+    embedDBFlush(state);
+    insertRecordsLinearly(10 * state->maxRecordsPerPage, 10 * state->maxRecordsPerPage, 10 * state->maxRecordsPerPage);
+    embedDBFlush(state);
+
+    /* Damage the newest superblock as if power was lost while writing it */
+    int8_t *page = (int8_t *)malloc(state->pageSize);
+    memset(page, 0x5A, state->pageSize);
+    id_t newestSlot = state->superblockSequence % 2 * state->eraseSizeInPages;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, state->fileInterface->write(page, newestSlot, state->pageSize, state->superblockFile), "Unable to overwrite the superblock.");
+    free(page);
+    state->parameters &= ~EMBEDDB_USE_SUPERBLOCK;
+    tearDownWithCheckpointFiles();
+
+    initializeEmbedDBWithCheckpointFiles(EMBEDDB_USE_SUPERBLOCK);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(20, state->nextDataPageId, "EmbedDB nextDataPageId is not correctly identified from the older superblock.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->minDataPageId, "EmbedDB minDataPageId is not correctly identified from the older superblock.");
+    int32_t key = 20 * state->maxRecordsPerPage;
+    int64_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find the last record after recovering from the older superblock.");
+    TEST_ASSERT_EQUAL_INT64_MESSAGE(key, data, "embedDBGet returned the wrong data after recovering from the older superblock.");
+    tearDownWithCheckpointFiles();
+    setupEmbedDB();
+}
+
 int runUnityTests() {
     UNITY_BEGIN();
     RUN_TEST(embedDB_parameters_initializes_from_data_file_with_twenty_seven_pages_correctly);
@@ -351,6 +596,13 @@ int runUnityTests() {
     RUN_TEST(embedDB_parameters_initializes_correctly_from_data_file_with_no_data);
     RUN_TEST(embedDB_recovery_algorithm_wraps_when_skipping_to_next_block);
     RUN_TEST(embedDB_recovery_algorithm_functions_correctly_when_have_wrapped_but_at_the_end_of_storage);
+    RUN_TEST(embedDB_returns_pages_written_after_they_were_read_ahead);
+    RUN_TEST(embedDB_recovery_finds_last_page_for_every_position_of_the_write_head);
+    RUN_TEST(embedDB_loads_spline_checkpoint_and_adds_pages_written_after_it);
+    RUN_TEST(embedDB_ignores_spline_checkpoint_from_a_different_data_file);
+    RUN_TEST(embedDB_recovers_from_superblock_and_pages_written_after_it);
+    RUN_TEST(embedDB_uses_older_superblock_when_newest_is_damaged);
+    RUN_TEST(embedDB_rebuilds_fence_pointers_after_reload_with_wrapped_data);
     return UNITY_END();
 }
 
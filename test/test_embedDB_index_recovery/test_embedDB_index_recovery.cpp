@@ -59,72 +59,99 @@
 #define tearDownFile tearDownSDFile
 #define DATA_FILE_PATH "dataFile.bin"
 #define INDEX_FILE_PATH "indexFile.bin"
+#define SUPERBLOCK_FILE_PATH "superblockFile.bin"
+#define BITMAP_FILE_PATH "bitmapFile.bin"
+#define SUMMARY_FILE_PATH "summaryFile.bin"
 #else
 #include "desktopFileInterface.h"
 #define DATA_FILE_PATH "build/artifacts/dataFile.bin"
 #define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
+#define SUPERBLOCK_FILE_PATH "build/artifacts/superblockFile.bin"
+#define BITMAP_FILE_PATH "build/artifacts/bitmapFile.bin"
+#define SUMMARY_FILE_PATH "build/artifacts/summaryFile.bin"
 #endif
 
 #include "unity.h"
 
 embedDBState *state;
+void *superblockFile;
+void *bitmapFile;
+void *summaryFile;
 
-void setupEmbedDB() {
+/* Allocates a state on the data and index files. Set any other fields, then call initializeEmbedDB */
+void allocateEmbedDB(uint32_t parameters, uint32_t numIndexPages) {
     state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate EmbedDB state.");
+    /* Fill the state with garbage so fields embedDBInit reads before setting them make the tests fail */
+    memset(state, 0xA5, sizeof(embedDBState));
     state->keySize = 4;
     state->dataSize = 4;
     state->pageSize = 512;
     state->bufferSizeInBlocks = 4;
     state->numSplinePoints = 8;
-    state->buffer = calloc(1, state->pageSize * state->bufferSizeInBlocks);
-    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
 
-    /* setup EmbedDB storage */
+    /* configure EmbedDB storage */
     state->fileInterface = getFileInterface();
     state->dataFile = setupFile(DATA_FILE_PATH);
     state->indexFile = setupFile(INDEX_FILE_PATH);
 
     state->numDataPages = 10000;
+    state->numIndexPages = numIndexPages;
     state->eraseSizeInPages = 2;
-    state->numIndexPages = 4;
     state->bitmapSize = 1;
-    state->parameters = EMBEDDB_USE_INDEX | EMBEDDB_RESET_DATA;
+    state->parameters = EMBEDDB_USE_INDEX | parameters;
     state->inBitmap = inBitmapInt8;
     state->updateBitmap = updateBitmapInt8;
     state->buildBitmapFromRange = buildBitmapInt8FromRange;
     state->compareKey = int32Comparator;
     state->compareData = int32Comparator;
-    int8_t result = embedDBInit(state, 1);
-    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
 }
 
-void initalizeEmbedDBFromFile() {
-    state = (embedDBState *)malloc(sizeof(embedDBState));
-    state->keySize = 4;
-    state->dataSize = 4;
-    state->pageSize = 512;
-    state->bufferSizeInBlocks = 4;
-    state->numSplinePoints = 8;
+/* Allocates the buffer for the state from allocateEmbedDB and initializes EmbedDB */
+void initializeEmbedDB(const char *message) {
     state->buffer = calloc(1, state->pageSize * state->bufferSizeInBlocks);
     TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate EmbedDB buffer.");
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, message);
+}
 
-    /* initialize EmbedDB storage */
-    state->fileInterface = getFileInterface();
-    state->dataFile = setupFile(DATA_FILE_PATH);
-    state->indexFile = setupFile(INDEX_FILE_PATH);
+void setupEmbedDB() {
+    allocateEmbedDB(EMBEDDB_RESET_DATA, 4);
+    initializeEmbedDB("EmbedDB did not initialize correctly.");
+}
 
-    state->numDataPages = 10000;
-    state->numIndexPages = 4;
-    state->eraseSizeInPages = 2;
-    state->bitmapSize = 1;
-    state->parameters = EMBEDDB_USE_INDEX;
-    state->inBitmap = inBitmapInt8;
-    state->updateBitmap = updateBitmapInt8;
-    state->buildBitmapFromRange = buildBitmapInt8FromRange;
-    state->compareKey = int32Comparator;
-    state->compareData = int32Comparator;
-    int8_t result = embedDBInit(state, 1);
-    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+void initalizeEmbedDBFromFile() {
+    allocateEmbedDB(0, 4);
+    initializeEmbedDB("EmbedDB did not initialize correctly.");
+}
+
+void initializeEmbedDBWithSuperblock(uint32_t parameters) {
+    allocateEmbedDB(EMBEDDB_USE_SUPERBLOCK | parameters, 4);
+    superblockFile = setupFile(SUPERBLOCK_FILE_PATH);
+    state->superblockFile = superblockFile;
+    initializeEmbedDB("EmbedDB did not initialize correctly with a superblock.");
+}
+
+void initializeEmbedDBWithBloomFilter(uint32_t parameters) {
+    allocateEmbedDB(EMBEDDB_USE_BLOOM_FILTER | parameters, 100);
+    state->bloomBitsPerKey = 10;
+    initializeEmbedDB("EmbedDB did not initialize correctly with Bloom filters.");
+}
+
+void initializeEmbedDBWithLearnedBitmap(uint32_t parameters) {
+    allocateEmbedDB(EMBEDDB_USE_BMAP | EMBEDDB_USE_LEARNED_BITMAP | parameters, 100);
+    bitmapFile = setupFile(BITMAP_FILE_PATH);
+    state->bitmapFile = bitmapFile;
+    state->bitmapSize = 2;
+    state->bitmapSampleSize = 1000;
+    initializeEmbedDB("EmbedDB did not initialize correctly with a learned bitmap.");
+}
+
+void initializeEmbedDBWithIndexSummary(uint32_t parameters) {
+    allocateEmbedDB(EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX_SUMMARY | parameters, 100);
+    summaryFile = setupFile(SUMMARY_FILE_PATH);
+    state->summaryFile = summaryFile;
+    initializeEmbedDB("EmbedDB did not initialize correctly with index summaries.");
 }
 
 void setUp() {
@@ -189,12 +216,208 @@ void embedDB_index_file_correctly_reloads_with_eleven_pages_of_data() {
     TEST_ASSERT_EQUAL_UINT32_MESSAGE(7, state->minIndexPageId, "EmbedDB minIndexPageId was initialized incorrectly when four index pages were present in the index file.");
 }
 
+void embedDB_index_file_recovers_from_superblock_and_pages_written_after_it() {
+    tearDown();
+    initializeEmbedDBWithSuperblock(EMBEDDB_RESET_DATA);
+    insertRecordsLinearly(100, 100, 125056);
+    embedDBFlush(state);
+
+    /* Wrap the index file after the superblock is written, then close without writing it again.
+     * This file interface does not erase, so scanning the file would still find the page in the erased block */
+    insertRecordsLinearly(125156, 125156, 93000);
+    id_t expectedNextIdxPageId = state->nextIdxPageId;
+    uint32_t expectedMinIndexPageId = state->minIndexPageId;
+    uint32_t expectedNumAvailIndexPages = state->numAvailIndexPages;
+    state->parameters &= ~EMBEDDB_USE_SUPERBLOCK;
+    tearDown();
+    tearDownFile(superblockFile);
+
+    initializeEmbedDBWithSuperblock(0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNextIdxPageId, state->nextIdxPageId, "EmbedDB nextIdxPageId from the superblock does not match the index file before closing.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedMinIndexPageId, state->minIndexPageId, "EmbedDB minIndexPageId from the superblock does not match the index file before closing.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNumAvailIndexPages, state->numAvailIndexPages, "EmbedDB numAvailIndexPages from the superblock does not match the index file before closing.");
+    tearDown();
+    tearDownFile(superblockFile);
+    setupEmbedDB();
+}
+
+/* Checks every even key from 0 to maxKey is found and that odd keys, which were never inserted, rarely read a data page */
+void checkBloomFilterLookups(int32_t maxKey) {
+    int32_t data = 0;
+    for (int32_t key = 0; key <= maxKey; key += 2) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record with Bloom filters.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(key / 2, data, "embedDBGet returned the wrong data with Bloom filters.");
+    }
+
+    /* Odd keys are looked up out of order, so the page each one is near is not already buffered */
+    embedDBResetStats(state);
+    int32_t numLookups = maxKey / 2;
+    for (int32_t i = 0; i < numLookups; i++) {
+        int32_t key = (int32_t)((uint32_t)i * 7919 % numLookups) * 2 + 1;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was never inserted.");
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(numLookups / 20, state->numReads, "Bloom filters did not rule out most pages for keys that were never inserted.");
+}
+
+void embedDBGet_skips_pages_ruled_out_by_bloom_filters() {
+    tearDown();
+    initializeEmbedDBWithBloomFilter(EMBEDDB_RESET_DATA);
+
+    /* The flush part way through writes a partial index page, so later index pages do not start at a multiple of the records per page */
+    for (int32_t i = 0; i < 20000; i++) {
+        int32_t key = i * 2;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &i), "embedDBPut did not correctly insert data (returned non-zero code)");
+        if (i == 9000)
+            embedDBFlush(state);
+    }
+    checkBloomFilterLookups(39998);
+
+    embedDBFlush(state);
+    tearDown();
+    initializeEmbedDBWithBloomFilter(0);
+    checkBloomFilterLookups(39998);
+    tearDown();
+    setupEmbedDB();
+}
+
+/* Checks a narrow data range returns every matching record and reads few of the data pages */
+void checkLearnedBitmapQuery() {
+    embedDBResetStats(state);
+    embedDBIterator it;
+    int32_t itKey = 0, itData = 0;
+    int32_t minData = 6500, maxData = 6520;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBInitIterator(state, &it);
+    int32_t inRange = 6510, outOfRange = 8000;
+    TEST_ASSERT_TRUE_MESSAGE(embedDBInBitmap(state, &inRange, it.queryBitmap), "embedDBInBitmap did not find a value in the query range.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInBitmap(state, &outOfRange, it.queryBitmap), "embedDBInBitmap found a value in a bucket outside the query range.");
+
+    int32_t numRecords = 0;
+    while (embedDBNext(state, &it, &itKey, &itData)) {
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(5000 + itKey % 1000 * 3, itData, "embedDBIterator returned the wrong data with a learned bitmap.");
+        TEST_ASSERT_TRUE_MESSAGE(itData >= minData && itData <= maxData, "embedDBIterator returned a record outside the data range with a learned bitmap.");
+        numRecords++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(70, numRecords, "embedDBIterator did not return every record in the data range with a learned bitmap.");
+
+    /* Only the pages written before the buckets were learned and the one or two pages per cycle holding the range should be read */
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(state->nextDataPageId / 2, state->numReads, "The learned bitmap did not rule out most data pages.");
+}
+
+void embedDBIterator_skips_pages_with_learned_bitmap_buckets() {
+    tearDown();
+    initializeEmbedDBWithLearnedBitmap(EMBEDDB_RESET_DATA);
+
+    /* The data values are all above the range the int8 bitmap functions split into buckets */
+    for (int32_t i = 0; i < 10000; i++) {
+        int32_t data = 5000 + i % 1000 * 3;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &i, &data), "embedDBPut did not correctly insert data (returned non-zero code)");
+    }
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(1, state->bitmapLearned, "The bitmap buckets were not learned once the sample was full.");
+    embedDBFlush(state);
+    checkLearnedBitmapQuery();
+
+    /* The buckets are loaded from the bitmap file on restart */
+    tearDown();
+    tearDownFile(bitmapFile);
+    initializeEmbedDBWithLearnedBitmap(0);
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(1, state->bitmapLearned, "The bitmap buckets were not reloaded from the bitmap file.");
+    checkLearnedBitmapQuery();
+
+    /* Records inserted with embedDBPutBatch are sampled too. The sample fills part way through the second batch and a page */
+    tearDown();
+    tearDownFile(bitmapFile);
+    initializeEmbedDBWithLearnedBitmap(EMBEDDB_RESET_DATA);
+    int32_t keys[700], values[700];
+    for (int32_t first = 0; first < 10000; first += 700) {
+        uint32_t numRecords = first + 700 <= 10000 ? 700 : 10000 - first;
+        for (uint32_t i = 0; i < numRecords; i++) {
+            keys[i] = first + i;
+            values[i] = 5000 + keys[i] % 1000 * 3;
+        }
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys, values, numRecords), "embedDBPutBatch did not correctly insert data (returned non-zero code)");
+    }
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(1, state->bitmapLearned, "The bitmap buckets were not learned from records inserted with embedDBPutBatch.");
+    embedDBFlush(state);
+    checkLearnedBitmapQuery();
+    tearDown();
+    tearDownFile(bitmapFile);
+    setupEmbedDB();
+}
+
+/* Checks a query for the one data page with small data reads only that page and its index page */
+void checkIndexSummaryQuery(int32_t matchingPage) {
+    embedDBResetStats(state);
+    embedDBIterator it;
+    int32_t itKey = 0, itData = 0;
+    int32_t minData = 0, maxData = 9;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBInitIterator(state, &it);
+
+    int32_t numRecords = 0;
+    while (embedDBNext(state, &it, &itKey, &itData)) {
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(matchingPage, itKey / state->maxRecordsPerPage, "embedDBIterator returned a record from a page that does not match.");
+        numRecords++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(state->maxRecordsPerPage, numRecords, "embedDBIterator did not return every matching record with index summaries.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->numIdxReads, "The index summaries did not rule out the other index pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->numReads, "embedDBIterator read data pages the index ruled out.");
+}
+
+void embedDBIterator_skips_index_pages_with_index_summaries() {
+    tearDown();
+    initializeEmbedDBWithIndexSummary(EMBEDDB_RESET_DATA);
+
+    /* Only one data page, part way through the fourth index page, holds data in the lowest bitmap bucket */
+    int32_t matchingPage = 1700;
+    int32_t numRecords = 3000 * state->maxRecordsPerPage;
+    for (int32_t i = 0; i < numRecords; i++) {
+        int32_t data = i / state->maxRecordsPerPage == matchingPage ? 5 : 150;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &i, &data), "embedDBPut did not correctly insert data (returned non-zero code)");
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(4, state->nextIdxPageId, "The test needs more index pages.");
+    checkIndexSummaryQuery(matchingPage);
+
+    /* The summaries are loaded from their checkpoint on restart */
+    embedDBFlush(state);
+    tearDown();
+    initializeEmbedDBWithIndexSummary(0);
+    checkIndexSummaryQuery(matchingPage);
+
+    /* Without a checkpoint they are rebuilt from the index pages */
+    tearDown();
+    tearDownFile(summaryFile);
+    embedDBFileInterface *fileInterface = getFileInterface();
+    summaryFile = setupFile(SUMMARY_FILE_PATH);
+    TEST_ASSERT_TRUE_MESSAGE(fileInterface->open(summaryFile, EMBEDDB_FILE_MODE_W_PLUS_B), "Unable to clear the summary file.");
+    fileInterface->close(summaryFile);
+    tearDownFile(summaryFile);
+    free(fileInterface);
+    initializeEmbedDBWithIndexSummary(0);
+    checkIndexSummaryQuery(matchingPage);
+    tearDown();
+    tearDownFile(summaryFile);
+    setupEmbedDB();
+}
+
 int runUnityTests() {
     UNITY_BEGIN();
     RUN_TEST(embedDB_index_file_correctly_reloads_with_no_data);
     RUN_TEST(embedDB_index_file_correctly_reloads_with_one_page_of_data);
     RUN_TEST(embedDB_index_file_correctly_reloads_with_four_pages_of_data);
     RUN_TEST(embedDB_index_file_correctly_reloads_with_eleven_pages_of_data);
+    RUN_TEST(embedDB_index_file_recovers_from_superblock_and_pages_written_after_it);
+    RUN_TEST(embedDBGet_skips_pages_ruled_out_by_bloom_filters);
+    RUN_TEST(embedDBIterator_skips_pages_with_learned_bitmap_buckets);
+    RUN_TEST(embedDBIterator_skips_index_pages_with_index_summaries);
     return UNITY_END();
 }
 
@@ -60,11 +60,13 @@
 #define DATA_FILE_PATH "dataFile.bin"
 #define INDEX_FILE_PATH "indexFile.bin"
 #define VAR_DATA_FILE_PATH "varFile.bin"
+#define SUPERBLOCK_FILE_PATH "superblockFile.bin"
 #else
 #include "desktopFileInterface.h"
 #define DATA_FILE_PATH "build/artifacts/dataFile.bin"
 #define INDEX_FILE_PATH "build/artifacts/indexFile.bin"
 #define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#define SUPERBLOCK_FILE_PATH "build/artifacts/superblockFile.bin"
 /* On the desktop platform, there is a file interface which simulates "erasing" by writing out all 1's to the location in the file ot be erased */
 #define MOCK_ERASE_INTERFACE
 #endif
@@ -73,16 +75,19 @@
 #define UNITY_SUPPORT_64
 
 embedDBState *state;
+void *superblockFile;
 
-void setupEmbedDB() {
+/* Allocates a state on the data and variable data files. Set any other fields, then call initializeEmbedDB */
+void allocateEmbedDB(uint32_t parameters) {
     state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate EmbedDB state.");
+    /* Fill the state with garbage so fields embedDBInit reads before setting them make the tests fail */
+    memset(state, 0xA5, sizeof(embedDBState));
     state->keySize = 4;
     state->dataSize = 4;
     state->pageSize = 512;
     state->bufferSizeInBlocks = 4;
     state->numSplinePoints = 8;
-    state->buffer = calloc(1, state->pageSize * state->bufferSizeInBlocks);
-    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate EmbedDB buffer.");
 
 /* configure EmbedDB storage */
 #ifdef MOCK_ERASE_INTERFACE
@@ -97,41 +102,48 @@ void setupEmbedDB() {
     state->numDataPages = 64;
     state->numVarPages = 76;
     state->eraseSizeInPages = 4;
-    state->parameters = EMBEDDB_USE_VDATA | EMBEDDB_RESET_DATA;
+    state->parameters = EMBEDDB_USE_VDATA | parameters;
     state->compareKey = int32Comparator;
     state->compareData = int32Comparator;
-    int8_t result = embedDBInit(state, 1);
-    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
 }
 
-void initalizeEmbedDBFromFile(void) {
-    state = (embedDBState *)malloc(sizeof(embedDBState));
-    state->keySize = 4;
-    state->dataSize = 4;
-    state->pageSize = 512;
-    state->bufferSizeInBlocks = 4;
-    state->numSplinePoints = 8;
+/* Allocates the buffer for the state from allocateEmbedDB and initializes EmbedDB */
+void initializeEmbedDB(const char *message) {
     state->buffer = calloc(1, state->pageSize * state->bufferSizeInBlocks);
     TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate EmbedDB buffer.");
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, message);
+}
 
-/* configure EmbedDB storage */
-#ifdef MOCK_ERASE_INTERFACE
-    state->fileInterface = getMockEraseFileInterface();
-#else
-    state->fileInterface = getFileInterface();
-#endif
-    char dataPath[] = DATA_FILE_PATH, varPath[] = VAR_DATA_FILE_PATH;
-    state->dataFile = setupFile(dataPath);
-    state->varFile = setupFile(varPath);
+void setupEmbedDB() {
+    allocateEmbedDB(EMBEDDB_RESET_DATA);
+    initializeEmbedDB("EmbedDB did not initialize correctly.");
+}
 
-    state->numDataPages = 64;
-    state->numVarPages = 76;
-    state->eraseSizeInPages = 4;
-    state->parameters = EMBEDDB_USE_VDATA;
-    state->compareKey = int32Comparator;
-    state->compareData = int32Comparator;
-    int8_t result = embedDBInit(state, 1);
-    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "Second EmbedDB did not initialize correctly.");
+void initalizeEmbedDBFromFile(void) {
+    allocateEmbedDB(0);
+    initializeEmbedDB("Second EmbedDB did not initialize correctly.");
+}
+
+void initializeEmbedDBWithSuperblock(uint32_t parameters) {
+    allocateEmbedDB(EMBEDDB_USE_SUPERBLOCK | parameters);
+    char superblockPath[] = SUPERBLOCK_FILE_PATH;
+    superblockFile = setupFile(superblockPath);
+    state->superblockFile = superblockFile;
+    initializeEmbedDB("EmbedDB did not initialize correctly with a superblock.");
+}
+
+void initializeEmbedDBWithIndex(uint32_t parameters) {
+    allocateEmbedDB(EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP | parameters);
+    char indexPath[] = INDEX_FILE_PATH;
+    state->indexFile = setupFile(indexPath);
+    state->bufferSizeInBlocks = 10;
+    state->numIndexPages = 8;
+    state->bitmapSize = 1;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    initializeEmbedDB("EmbedDB did not initialize correctly with an index.");
 }
 
 void tearDownEmbedDB() {
@@ -336,6 +348,83 @@ void embedDB_variable_data_reloads_and_queries_with_two_hundred_forty_seven_page
     tearDownEmbedDB();
 }
 
+void embedDB_variable_data_recovers_from_superblock_and_pages_written_after_it() {
+    tearDownEmbedDB();
+    tearDown();
+    initializeEmbedDBWithSuperblock(EMBEDDB_RESET_DATA);
+    insertRecords(651, 1000, 10);
+    embedDBFlush(state);
+
+    /* Wrap the variable data file after the superblock is written, then close without writing it again */
+    insertRecords(1000, 1651, 661);
+    state->parameters &= ~EMBEDDB_USE_SUPERBLOCK;
+    tearDownEmbedDB();
+    tearDownFile(superblockFile);
+    tearDown();
+
+    /* Scan the files to compare against */
+    initalizeEmbedDBFromFile();
+    id_t expectedNextDataPageId = state->nextDataPageId;
+    id_t expectedNextVarPageId = state->nextVarPageId;
+    uint32_t expectedNumAvailVarPages = state->numAvailVarPages;
+    uint64_t expectedMinVarRecordId = state->minVarRecordId;
+    id_t expectedCurrentVarLoc = state->currentVarLoc;
+    tearDownEmbedDB();
+    tearDown();
+
+    initializeEmbedDBWithSuperblock(0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNextDataPageId, state->nextDataPageId, "EmbedDB nextDataPageId from the superblock does not match scanning the data file.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNextVarPageId, state->nextVarPageId, "EmbedDB nextVarPageId from the superblock does not match scanning the variable data file.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNumAvailVarPages, state->numAvailVarPages, "EmbedDB numAvailVarPages from the superblock does not match scanning the variable data file.");
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&expectedMinVarRecordId, &state->minVarRecordId, state->keySize, "EmbedDB minVarRecordId from the superblock does not match scanning the variable data file.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedCurrentVarLoc, state->currentVarLoc, "EmbedDB currentVarLoc from the superblock does not match scanning the variable data file.");
+
+    int32_t key = 2600, recordData = 0;
+    char variableData[13] = "Hello World!";
+    char variableDataBuffer[13];
+    embedDBVarDataStream *stream = NULL;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &recordData, &stream), "EmbedDB get did not find a record written after the superblock.");
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(1610, recordData, "EmbedDB get did not return correct data for a record written after the superblock.");
+    TEST_ASSERT_NOT_NULL_MESSAGE(stream, "EmbedDB get var returned null stream for a record written after the superblock.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(13, embedDBVarDataStreamRead(state, stream, variableDataBuffer, 13), "EmbedDB var data stream did not read the correct number of bytes.");
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(variableData, variableDataBuffer, 13, "EmbedDB get var did not return the correct variable data after recovering from the superblock.");
+    free(stream);
+    tearDownEmbedDB();
+    tearDownFile(superblockFile);
+}
+
+void embedDB_variable_data_and_index_recover_together() {
+    tearDownEmbedDB();
+    tearDown();
+    initializeEmbedDBWithIndex(EMBEDDB_RESET_DATA);
+    insertRecords(63000, 1000, 10);
+    embedDBFlush(state);
+    id_t expectedNextDataPageId = state->nextDataPageId;
+    id_t expectedNextIdxPageId = state->nextIdxPageId;
+    id_t expectedNextVarPageId = state->nextVarPageId;
+    tearDownEmbedDB();
+    tearDownFile(state->indexFile);
+    tearDown();
+
+    initializeEmbedDBWithIndex(0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNextDataPageId, state->nextDataPageId, "EmbedDB nextDataPageId was not recovered correctly with an index.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNextIdxPageId, state->nextIdxPageId, "EmbedDB nextIdxPageId was not recovered correctly with variable data.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedNextVarPageId, state->nextVarPageId, "EmbedDB nextVarPageId was not recovered correctly with an index.");
+
+    int32_t key = 64000, recordData = 0;
+    char variableData[13] = "Hello World!";
+    char variableDataBuffer[13];
+    embedDBVarDataStream *stream = NULL;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &recordData, &stream), "EmbedDB get did not find the last record after recovering with an index.");
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(63010, recordData, "EmbedDB get did not return correct data after recovering with an index.");
+    TEST_ASSERT_NOT_NULL_MESSAGE(stream, "EmbedDB get var returned null stream after recovering with an index.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(13, embedDBVarDataStreamRead(state, stream, variableDataBuffer, 13), "EmbedDB var data stream did not read the correct number of bytes.");
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(variableData, variableDataBuffer, 13, "EmbedDB get var did not return the correct variable data after recovering with an index.");
+    free(stream);
+    tearDownEmbedDB();
+    tearDownFile(state->indexFile);
+}
+
 int runUnityTests() {
     UNITY_BEGIN();
     RUN_TEST(embedDB_variable_data_page_numbers_are_correct);
@@ -346,6 +435,8 @@ int runUnityTests() {
     RUN_TEST(embedDB_variable_data_reloads_with_fifty_three_pages_of_data_correctly);
     RUN_TEST(embedDB_variable_data_reloads_and_queries_with_thirty_one_pages_of_data_correctly);
     RUN_TEST(embedDB_variable_data_reloads_and_queries_with_two_hundred_forty_seven_pages_of_data_correctly);
+    RUN_TEST(embedDB_variable_data_recovers_from_superblock_and_pages_written_after_it);
+    RUN_TEST(embedDB_variable_data_and_index_recover_together);
     return UNITY_END();
 }
 
@@ -258,10 +258,42 @@ void should_clean_spline_when_data_overwritten() {
     TEST_ASSERT_EQUAL_UINT32_MESSAGE(2, state->spl->count, "embedDB spline point count should be two after erasing an earlier spline point that is not needed.");
 }
 
+void radix_table_finds_same_pages_after_points_wrap_and_erase() {
+    spline withoutRadix, withRadix;
+    splineInit(&withoutRadix, 32, 1, sizeof(uint32_t));
+    splineInit(&withRadix, 32, 1, sizeof(uint32_t));
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, splineInitRadix(&withRadix, 6), "splineInitRadix was unable to allocate the radix table.");
+
+    /* Alternate dense and sparse keys so points are added often and the ring of points wraps several times */
+    uint32_t key = 1000;
+    for (uint32_t page = 0; page < 3000; page++) {
+        key += page % 200 < 100 ? 1 + page % 7 : 500 + page % 1500;
+        splineAdd(&withoutRadix, &key, page);
+        splineAdd(&withRadix, &key, page);
+        if (page % 150 == 0 && withoutRadix.count > 8) {
+            splineErase(&withoutRadix, 4);
+            splineErase(&withRadix, 4);
+        }
+
+        for (uint32_t queryKey = key - 3000; page % 50 == 0 && queryKey <= key; queryKey += 7) {
+            id_t loc, low, high, radixLoc, radixLow, radixHigh;
+            splineFind(&withoutRadix, &queryKey, int32Comparator, &loc, &low, &high);
+            splineFind(&withRadix, &queryKey, int32Comparator, &radixLoc, &radixLow, &radixHigh);
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(loc, radixLoc, "splineFind with a radix table estimated a different page.");
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(low, radixLow, "splineFind with a radix table returned a different lower bound.");
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(high, radixHigh, "splineFind with a radix table returned a different upper bound.");
+        }
+    }
+
+    splineClose(&withoutRadix);
+    splineClose(&withRadix);
+}
+
 int runUnityTests() {
     UNITY_BEGIN();
     RUN_TEST(should_erase_previous_spline_points_when_full);
     RUN_TEST(should_clean_spline_when_data_overwritten);
+    RUN_TEST(radix_table_finds_same_pages_after_points_wrap_and_erase);
     return UNITY_END();
 }
 